@@ -0,0 +1,60 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _DELTA_DELTA_HPP_
+#define _DELTA_DELTA_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+#include "grid/grid.hpp"
+#include "quadtree/tree.hpp"
+
+namespace terrain::delta {
+
+///! \brief a rectangle of cells, which all take on the same new value
+struct Change {
+public:
+    ///! cell index of the rectangle's south-west corner
+    uint32_t i;
+    uint32_t j;
+
+    ///! size of the rectangle, in cells
+    uint32_t width;
+    uint32_t height;
+
+    geometry::cell_value_t value;
+
+    inline bool operator==(const Change& other) const {
+        return (i == other.i) && (j == other.j) && (width == other.width) && (height == other.height) && (value == other.value);
+    }
+};
+
+///! \brief the changes turning one terrain into another; applied in order
+typedef std::vector<Change> Delta;
+
+///! \brief lists the rectangles of cells whose values differ between `from` and `to`, with their values in `to`
+///!
+///! Walks both trees in lock-step.  Subtrees that are shared between the two (i.e. copy-on-write versions of
+///! one another, or shared by `compact()`) are skipped without being visited, as are equal uniform areas;
+///! and wherever `to` is uniform, the whole area is emitted as a single change.
+///! Throws `std::invalid_argument` unless both trees have the same layout.
+Delta diff(const quadtree::Tree& from, const quadtree::Tree& to);
+
+///! \brief as above, for grids: compares `storage` row by row, 32 cells at a time with AVX2 (see `AVX2_ON`)
+///!
+///! Each row's differing cells become runs of equal new values; identical runs in consecutive rows are merged
+///! into one rectangle.  Rows are compared in parallel.  Throws `std::invalid_argument`
+///! unless both grids have the same layout.
+Delta diff(const grid::Grid& from, const grid::Grid& to);
+
+///! \brief writes each change into `target`, in order; `target` should have the layout the delta was taken over
+void apply_delta(quadtree::Tree& target, const Delta& delta);
+
+///! \brief as above, for grids.  Keeps any pyramid or summed-area table up to date.
+void apply_delta(grid::Grid& target, const Delta& delta);
+
+} // namespace terrain::delta
+
+#endif // #ifndef _DELTA_DELTA_HPP_
@@ -5,6 +5,7 @@
 #define _CELL_VALUE_HPP_
 
 #include <cmath>
+#include <cstdint>
 
 namespace terrain::geometry {
 
@@ -26,7 +27,46 @@ typedef uint8_t cell_value_t;
 
 constexpr cell_value_t cell_error_value   = 0xAB;
 constexpr cell_value_t cell_default_value = 0x99;
-    
+
+///! \brief describes the contents of a region, as answered by the region queries (i.e. `query_box`)
+enum class Occupancy : uint8_t { Free, Blocked, Mixed };
+
+///! \brief any non-zero cell is treated as blocked (i.e. the loaders write 'allow' as zero)
+constexpr bool is_blocked(const cell_value_t value){ return 0 < value; }
+
+///! \brief classifies a region by the smallest and largest value it contains
+constexpr Occupancy classify_range(const cell_value_t minimum, const cell_value_t maximum){
+    if( ! is_blocked(maximum) ){
+        return Occupancy::Free;
+    }else if( is_blocked(minimum) ){
+        return Occupancy::Blocked;
+    }
+    return Occupancy::Mixed;
+}
+
+// Occupancy maps (see `integrate_scan`) store log-odds instead: a biased byte, where 0x80 means 'unknown',
+// larger values lean 'occupied', and smaller values lean 'free'.  Updates saturate at 0 and 0xFF.
+// Such a terrain must start out unknown, i.e. from `reset(layout, log_odds_unknown)` or `fill(log_odds_unknown)`.
+// Its values do not follow `is_blocked` (an unknown cell is non-zero); so threshold it at `log_odds_occupied`
+// (see `grid::threshold` and `Tree::threshold`) before handing it to the blocked / free queries, e.g.
+// `query_box`, `count_blocked`, `first_hit(is_blocked)`, the distance transform, or the planner.
+constexpr cell_value_t log_odds_unknown = 0x80;
+///! the smallest log-odds value that leans 'occupied'
+constexpr cell_value_t log_odds_occupied = log_odds_unknown + 1;
+///! added to the cell where a ray ends
+constexpr int log_odds_hit = 12;
+///! added to every cell a ray passes through, before its end
+constexpr int log_odds_miss = -4;
+
+///! \brief adds `delta` to a log-odds value, saturating at the ends of its range
+constexpr cell_value_t update_log_odds(const cell_value_t value, const int delta){
+    const int updated = static_cast<int>(value) + delta;
+    return static_cast<cell_value_t>( (updated < 0) ? 0 : ((0xFF < updated) ? 0xFF : updated) );
+}
+
+///! \brief whether a log-odds value leans 'occupied'
+constexpr bool is_occupied(const cell_value_t value){ return log_odds_occupied <= value; }
+
 } // namespace terrain::geometry
 
 #endif // _CELL_VALUE_HPP_
@@ -4,6 +4,9 @@
 #ifndef _INTERPOLATE_HPP_
 #define _INTERPOLATE_HPP_
 
+#include <cstddef>
+#include <vector>
+
 #include <Eigen/Geometry>
 
 #include "geometry/cell_value.hpp"
@@ -20,11 +23,34 @@ namespace terrain::geometry {
  */
 cell_value_t interpolate_linear( const Eigen::Vector2d& at, const Sample& s1, const Sample& s2);
 
+///! \brief an axis-aligned rectangle of four samples, for bilinear interpolation
+struct BilinearCorners {
+    ///! the rectangle's sides: i.e. the samples' x and y coordinates
+    double x_west;
+    double x_east;
+    double y_south;
+    double y_north;
+
+    ///! the samples' values, at each corner
+    cell_value_t sw;
+    cell_value_t se;
+    cell_value_t nw;
+    cell_value_t ne;
+};
+
+///! \brief bilinear interpolation at `at`, over the rectangle `corners`
+///!
+///! Uses the separable weights directly, rounded once, at the end; exactly as the batch version below.  A query
+///! outside of the rectangle takes the value at the nearest point of the rectangle; and a rectangle of zero width
+///! or height collapses onto its west or south side.
+cell_value_t interpolate_bilinear( const Eigen::Vector2d& at, const BilinearCorners& corners);
+
 /**
  * Performs bilinear-interpolation: 
  * http://en.wikipedia.org/wiki/Bilinear_Interpolation
  * 
- * Warning: Undefined behavior, if interpolation happens outside of the rectangle defined by the 4 samples
+ * The samples must lie on the corners of an axis-aligned rectangle; each is placed by its own position, so their
+ * order does not matter.  Weights as for `BilinearCorners`, above.
  * 
  * @param the x,y coordinates to interpolate at.
  * @param ne quadrant sample point
@@ -35,6 +61,41 @@ cell_value_t interpolate_linear( const Eigen::Vector2d& at, const Sample& s1, co
  */
 cell_value_t interpolate_bilinear( const Eigen::Vector2d& at, const Sample& ne, const Sample& nw, const Sample& sw, const Sample& se);
 
+///! \brief structure-of-arrays input for the batch `interpolate_bilinear`: one query point, and the
+///! axis-aligned rectangle of four samples around it, per entry
+struct BilinearBatch {
+    ///! query points
+    std::vector<double> x;
+    std::vector<double> y;
+
+    ///! the rectangle's sides: i.e. the samples' x and y coordinates
+    std::vector<double> x_west;
+    std::vector<double> x_east;
+    std::vector<double> y_south;
+    std::vector<double> y_north;
+
+    ///! the samples' values, at each corner
+    std::vector<cell_value_t> sw;
+    std::vector<cell_value_t> se;
+    std::vector<cell_value_t> nw;
+    std::vector<cell_value_t> ne;
+
+    void resize(const size_t count);
+
+    ///! \brief writes entry `index`: the query point `at`, and the rectangle around it
+    void set(const size_t index, const Eigen::Vector2d& at, const BilinearCorners& corners);
+
+    inline size_t size() const { return x.size(); }
+};
+
+///! \brief bilinear interpolation over a whole batch of points: `values[n]` for the n'th entry of `batch`
+///!
+///! Same weights and rounding as the single-point version, above.
+///!
+///! When built for AVX2 / FMA (see `AVX2_ON` in CMakeLists.txt), four points are interpolated per instruction;
+///! otherwise, this falls back to an equivalent scalar loop.  Blocks of the batch run in parallel.
+void interpolate_bilinear( const BilinearBatch& batch, std::vector<cell_value_t>& values);
+
 } // namespace terrain::geometry
 
 #endif // #ifndef _INTERPOLATE_HPP_
@@ -4,6 +4,9 @@
 #ifndef _GRID_LAYOUT_HPP_
 #define _GRID_LAYOUT_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
@@ -28,8 +31,24 @@ public:
 
     constexpr Layout(const double _precision, const double _x, const double _y, const double _width);
 
+    ///! \brief clips the segment `from` -> `to` against this layout's bounds
+    ///!
+    ///! On success, the clipped segment runs over the parameters [t_enter, t_exit] of `from + t*(to - from)`.
+    ///! \return false if the segment misses the bounds entirely
+    bool clip(const Eigen::Vector2d& from, const Eigen::Vector2d& to, double& t_enter, double& t_exit) const;
+
     bool contains(const Eigen::Vector2d& at) const;
 
+    ///! \brief Walks the cells that the segment `from` -> `to` passes through, in order (a 2D-DDA walk)
+    ///!
+    ///! The segment is clipped to this layout first; each cell is visited exactly once.
+    ///! Through an exact corner, the walk steps diagonally, and visits neither side-cell.
+    ///!
+    ///! \param visit - callable as `bool visit(uint32_t i, uint32_t j, double t)`: the cell's column and row, and
+    ///!                the segment parameter where the walk enters it.  Returning true stops the walk.
+    template<typename visitor_t>
+    void trace(const Eigen::Vector2d& from, const Eigen::Vector2d& to, visitor_t visit) const;
+
     bool operator!=(const Layout& other) const;
     bool operator==(const Layout& other) const;
 
@@ -97,3 +97,65 @@ constexpr index_t Layout::zhash( const double x_p, const double y_p) const {
 constexpr index_t Layout::zhash( const uint32_t i, const uint32_t j) const {
     return (interleave(i) + (interleave(j) << 1)) << padding;
 }
+
+template<typename visitor_t>
+void Layout::trace(const Eigen::Vector2d& from, const Eigen::Vector2d& to, visitor_t visit) const {
+    double t_enter, t_exit;
+    if( ! clip(from, to, t_enter, t_exit) ){
+        return;
+    }
+
+    // Amanatides & Woo: "A Fast Voxel Traversal Algorithm for Ray Tracing" (1987)
+    const Eigen::Vector2d delta = to - from;
+    const Eigen::Vector2d entry = from + t_enter * delta;
+    const int64_t cells = static_cast<int64_t>(dimension);
+    const double lower[2] = {get_x_min(), get_y_min()};
+
+    int64_t index[2];
+    int64_t step[2];
+    double t_next[2];   // parameter at which the segment crosses into the next cell, along each axis
+    double t_delta[2];  // parameter distance between successive crossings, along each axis
+    for( int axis = 0; axis < 2; ++axis ){
+        const double offset = (entry[axis] - lower[axis]) / precision;
+        // a segment starting on a cell border, heading in the negative direction, starts in the lower cell
+        index[axis] = static_cast<int64_t>( (delta[axis] < 0) ? std::ceil(offset) - 1 : std::floor(offset) );
+        index[axis] = std::max<int64_t>(0, std::min(cells - 1, index[axis]));
+
+        if( 0 < delta[axis] ){
+            step[axis] = 1;
+            t_next[axis] = (lower[axis] + (index[axis] + 1) * precision - from[axis]) / delta[axis];
+            t_delta[axis] = precision / delta[axis];
+        }else if( delta[axis] < 0 ){
+            step[axis] = -1;
+            t_next[axis] = (lower[axis] + index[axis] * precision - from[axis]) / delta[axis];
+            t_delta[axis] = -precision / delta[axis];
+        }else{
+            step[axis] = 0;
+            t_next[axis] = std::numeric_limits<double>::infinity();
+            t_delta[axis] = std::numeric_limits<double>::infinity();
+        }
+    }
+
+    double t = t_enter;
+    while( true ){
+        if( visit(static_cast<uint32_t>(index[0]), static_cast<uint32_t>(index[1]), t) ){
+            return;
+        }
+
+        // advance along whichever axis crosses next -- or both, through an exact corner
+        t = std::min(t_next[0], t_next[1]);
+        if( t_exit <= t ){
+            return;
+        }
+        for( int axis = 0; axis < 2; ++axis ){
+            if( t == t_next[axis] ){
+                index[axis] += step[axis];
+                t_next[axis] += t_delta[axis];
+            }
+        }
+
+        if( (index[0] < 0) || (index[1] < 0) || (cells <= index[0]) || (cells <= index[1]) ){
+            return;
+        }
+    }
+}
@@ -17,6 +17,17 @@ struct Sample {
 public:
     const Eigen::Vector2d at;
     const terrain::geometry::cell_value_t is;
+
+    ///! width of the (square) cell or leaf that answered; NAN if the sample was not taken from a terrain
+    const double width = NAN;
+};
+
+///! \brief a horizontal run of cells with identical values, spanning [x_begin, x_end)
+struct Run {
+public:
+    double x_begin;
+    double x_end;
+    terrain::geometry::cell_value_t is;
 };
 
 } // namespace terrain
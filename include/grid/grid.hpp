@@ -7,6 +7,8 @@
 #include <cmath>
 #include <memory>
 #include <cstdlib>
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -17,10 +19,16 @@
 #include "geometry/cell_value.hpp"
 #include "geometry/polygon.hpp"
 #include "geometry/layout.hpp"
+#include "geometry/sample.hpp"
+#include "grid/pyramid.hpp"
+#include "grid/summed_area.hpp"
 
 using terrain::geometry::Layout;
 using terrain::geometry::cell_value_t;
+using terrain::geometry::Occupancy;
 using terrain::geometry::Polygon;
+using terrain::geometry::Run;
+using terrain::geometry::Sample;
 
 
 namespace terrain::grid {
@@ -42,11 +50,36 @@ public:
      */
     Grid(const Layout& _layout);
 
+    ///! \brief copies the cells, and any pyramid or summed-area table built over them
+    ///!
+    ///! A copied summed-area table comes out up to date, so the copy may be read from several threads at once.
+    Grid(const Grid& other);
+
+    Grid(Grid&& other) = default;
+
+    ///! \brief replaces the cells, and any pyramid or summed-area table, with copies of `other`'s; as the copy constructor
+    Grid& operator=(const Grid& other);
+
+    Grid& operator=(Grid&& other) = default;
+
     /**
      *  Releases all memory associated with this quad tree.
      */
     ~Grid(){};
 
+    ///! \brief builds (or rebuilds) the optional min/max pyramid over this grid's cells.
+    ///!
+    ///! Once built, the pyramid is kept up to date by `store` and `fill`, and accelerates `query_box`.
+    ///! Call this again after writing to `storage` directly.
+    void build_pyramid();
+
+    ///! \brief builds (or rebuilds) the optional summed-area table over this grid's cells.
+    ///!
+    ///! Once built, `count_blocked` answers in four lookups.  `store` and `fill` mark rows dirty, and the
+    ///! next count recomputes only the table rows from the lowest dirty row upwards.
+    ///! Call this again after writing to `storage` directly.
+    void build_summed_area();
+
     /**
      * Returns true if the point at (x, y) exists in the tree.
      *
@@ -55,6 +88,16 @@ public:
      */
     bool contains(const Eigen::Vector2d& p) const;
 
+    ///! \brief Counts the blocked cells overlapping the axis-aligned box [min, max)
+    ///!
+    ///! Only cells inside this grid are counted.  Without a summed-area table, this scans every covered cell.
+    ///! Note: the first count after a write refreshes the table, and so must not race with other counts.
+    ///!
+    ///! \param min - lower-left corner of the box
+    ///! \param max - upper-right corner of the box
+    ///! \return number of blocked cells
+    size_t count_blocked(const Eigen::Vector2d& min, const Eigen::Vector2d& max) const;
+
     ///! \brief Draws a simple debug representation of this grid to stderr
     void debug() const;
 
@@ -68,6 +111,26 @@ public:
     ///! @param fill_value -fill value for area
     void fill(const Polygon& source, const cell_value_t fill_value);
 
+    ///! \brief Walks the segment `from` -> `to`, cell by cell, and returns the first cell whose value satisfies `predicate`
+    ///!
+    ///! Visits every cell the segment passes through, in order (a 2D-DDA walk), so nothing is skipped or sampled twice.
+    ///! The segment is clipped to this grid first.
+    ///!
+    ///! \param from - start of the segment
+    ///! \param to - end of the segment
+    ///! \param predicate - test for a 'hit', e.g. `is_blocked`
+    ///! \return the point where the segment enters the hit cell, and that cell's value; or nothing, if no cell matched.
+    std::optional<Sample> first_hit(const Eigen::Vector2d& from, const Eigen::Vector2d& to,
+                                    const std::function<bool(cell_value_t)>& predicate) const;
+
+    ///! \brief Updates log-odds occupancy from one sensor scan: a ray from `origin` to each endpoint
+    ///!
+    ///! Each cell a ray passes through is nudged towards 'free' (`log_odds_miss`), and the cell where it ends,
+    ///! if inside the grid, towards 'occupied' (`log_odds_hit`); values saturate (see `update_log_odds`).
+    ///! Each ray's cells are gathered into a contiguous buffer, updated in one branch-free pass, and scattered back.
+    ///! Start from `fill(log_odds_unknown)`, and `threshold` the result for the blocked / free queries.
+    void integrate_scan(const Eigen::Vector2d& origin, const std::vector<Eigen::Vector2d>& endpoints);
+
     /**
      * Get the overall bounds of this tree
      *
@@ -84,20 +147,49 @@ public:
 
     size_t get_memory_usage() const;
 
+    inline bool has_pyramid() const { return static_cast<bool>(pyramid); }
+
+    inline bool has_summed_area() const { return static_cast<bool>(summed_area); }
+
     ///! the spacing of each cell === center-to-center distance. === cell-width.
     double get_precision() const;
 
     inline void prune() {};
 
+    ///! \brief Copies every cell of this grid into an image buffer, north-up: row 0 is the northernmost row of cells.
+    ///!
+    ///! \param buffer - destination; must hold at least `dimension` rows of `stride` bytes
+    ///! \param stride - distance, in bytes, between the starts of successive rows.  At least `dimension`.
+    void rasterize_into(cell_value_t* buffer, const size_t stride) const;
+
     void reset();
     void reset(const Layout& _layout);
 
+    ///! \brief resets the grid to the new layout, with every cell set to `fill_value`
+    void reset(const Layout& _layout, const cell_value_t fill_value);
+
+    ///! \brief Lists the runs of identical values along the row of cells containing `y`, from west to east.
+    ///!
+    ///! \param y - the row to scan
+    ///! \param runs - output; cleared first.  Empty if `y` lies outside of the grid.
+    void scan_row(const double y, std::vector<Run>& runs) const;
+
     ///! \brief Retrieve the value at an (x, y) Eigen::Vector2d
     ///!
     ///! \param Eigen::Vector2d - the x,y coordinates to search at
     ///! \return the cell value
     cell_value_t classify(const Eigen::Vector2d& p) const;
 
+    ///! \brief Summarizes every cell overlapping the axis-aligned box [min, max)
+    ///!
+    ///! Parts of the box outside of this grid read as the default value, just as `classify` does.
+    ///! With a pyramid built, this visits O(log(dimension)) blocks per box edge, instead of every cell.
+    ///!
+    ///! \param min - lower-left corner of the box
+    ///! \param max - upper-right corner of the box
+    ///! \return whether the box is entirely free, entirely blocked, or mixed
+    Occupancy query_box(const Eigen::Vector2d& min, const Eigen::Vector2d& max) const;
+
     ///! \brief the _total_ number of cells in this grid === (width * height)
     size_t size() const;
 
@@ -107,6 +199,22 @@ public:
     ///! \return reference to the cell value
     bool store(const Eigen::Vector2d& p, const cell_value_t new_value);
 
+    ///! \brief stores many values at once: `values[n]` at `points[n]`.  Points outside the grid are skipped.
+    ///!
+    ///! The writes are radix-sorted by storage index first, so they land in memory order.
+    ///! If several points share a cell, the last one wins.  Each point goes to the same cell as with `store`,
+    ///! so `classify` reads it back from there.  Throws `std::invalid_argument` unless there is one value per point.
+    void store_batch(const std::vector<Eigen::Vector2d>& points, const std::vector<cell_value_t>& values);
+
+    ///! \brief copies a rectangular block of cells at once, from a north-up image, straight into storage
+    ///!
+    ///! \param i0, j0 - cell index of the block's south-west corner
+    ///! \param width, height - size of the block, in cells.  Must lie inside the layout.
+    ///! \param source - the block's values; row 0 is the block's northernmost row
+    ///! \param stride - distance, in bytes, between the starts of successive rows of `source`
+    void store_block(const size_t i0, const size_t j0, const size_t width, const size_t height,
+                     const cell_value_t* source, const size_t stride);
+
     bool to_png(const std::string filename) const;
 
 public:
@@ -116,6 +224,19 @@ public:
     // raw array:  2D addressing is performed through the class methods
     std::vector<cell_value_t> storage;
 
+private:
+    ///! optional min/max summaries of `storage`; see `build_pyramid`
+    std::unique_ptr<Pyramid> pyramid;
+
+    ///! optional blocked-cell counts of `storage`; see `build_summed_area`
+    std::unique_ptr<SummedAreaTable> summed_area;
+
+private:
+    ///! \brief converts a box [min, max) into the inclusive range of cells it overlaps
+    ///! \return false if the box lies entirely outside this grid
+    bool clip_box(const Eigen::Vector2d& min, const Eigen::Vector2d& max,
+                  size_t& i0, size_t& j0, size_t& i1, size_t& j1, bool& overhangs) const;
+
 private:
     friend class GridTest_SnapPrecision_Test;
     friend class GridTest_XYToIndex_Test;
@@ -0,0 +1,47 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _GRID_OPERATIONS_HPP_
+#define _GRID_OPERATIONS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "geometry/cell_value.hpp"
+#include "grid/grid.hpp"
+
+using terrain::geometry::cell_value_t;
+
+namespace terrain::grid {
+
+///! \brief how `combine` merges two grids, cell by cell
+enum class Operation : uint8_t {
+    And,            ///< bitwise and
+    Or,             ///< bitwise or
+    Max,            ///< the larger value: blocked where either is blocked
+    Min,            ///< the smaller value: blocked only where both are blocked
+    AddSaturated    ///< the sum, clamped to 0xFF
+};
+
+// Whole-grid operations over `storage`, for compositing layers (e.g. allow, block and dynamic obstacles).
+// Each runs over blocks of rows in parallel; and when built for AVX2 (see `AVX2_ON` in CMakeLists.txt),
+// over 32 cells per instruction, with a scalar loop for the remainder.  Any pyramid or summed-area table
+// of a written grid is rebuilt afterwards.
+
+///! \brief sets each cell of `target` to `op(target, source)`
+///!
+///! Throws `std::invalid_argument`, leaving `target` untouched, unless both grids have the same layout.
+void combine(Grid& target, const Grid& source, const Operation op);
+
+///! \brief turns `target` into a mask: 0xFF wherever a cell is at least `level`, and 0 elsewhere
+///!
+///! e.g. at `log_odds_occupied`, to read an occupancy grid (see `Grid::integrate_scan`) as blocked / free.
+void threshold(Grid& target, const cell_value_t level);
+
+///! \brief counts the cells holding each value; entry `v` is the number of cells equal to `v`
+std::array<size_t, 256> histogram(const Grid& source);
+
+} // namespace terrain::grid
+
+#endif // #ifndef _GRID_OPERATIONS_HPP_
@@ -0,0 +1,67 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _GRID_PYRAMID_HPP_
+#define _GRID_PYRAMID_HPP_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+
+using terrain::geometry::cell_value_t;
+
+namespace terrain::grid {
+
+///! \brief min/max mip-pyramid over a square, power-of-2 grid of cells
+///!
+///! Level 0 is the grid's own storage (and is not duplicated here); each level `k` above it stores
+///! the minimum and maximum of the 2x2 block of cells beneath it, so level `k` has `(dimension >> k)^2` entries.
+///! Region queries then resolve whole aligned blocks with a single lookup, instead of scanning every cell.
+class Pyramid {
+public:
+    ///! \param dimension - number of cells along each side of the source grid.  Must be a power of 2.
+    Pyramid(const size_t dimension);
+
+    ///! \brief recomputes every level from the given cells.  Rows of each level are built in parallel.
+    void build(const std::vector<cell_value_t>& cells);
+
+    ///! \brief sets every level to the given value, matching a fill of the source grid
+    void fill(const cell_value_t value);
+
+    size_t get_memory_usage() const;
+
+    ///! \brief returns the smallest and largest values within the inclusive cell range [i0, i1] x [j0, j1]
+    ///!
+    ///! Returns early, once the range is known to contain both free and blocked cells.
+    std::pair<cell_value_t,cell_value_t> summarize(const std::vector<cell_value_t>& cells,
+                                                   const size_t i0, const size_t j0,
+                                                   const size_t i1, const size_t j1) const;
+
+    ///! \brief propagates a change of the cell at (i,j) up through the levels
+    ///!
+    ///! Stops as soon as a level's summary is unchanged.  Runs in O(log(dimension)).
+    void update(const std::vector<cell_value_t>& cells, size_t i, size_t j);
+
+    ///! \brief recomputes every summary above the inclusive cell range [i0, i1] x [j0, j1], after a bulk write
+    void update_region(const std::vector<cell_value_t>& cells, size_t i0, size_t j0, size_t i1, size_t j1);
+
+private:
+    void build_level(const std::vector<cell_value_t>& cells, const size_t level);
+
+    void summarize(const std::vector<cell_value_t>& cells, const size_t level, const size_t bi, const size_t bj,
+                   const size_t i0, const size_t j0, const size_t i1, const size_t j1,
+                   cell_value_t& minimum, cell_value_t& maximum) const;
+
+private:
+    size_t dimension;
+
+    // minimums[k-1] and maximums[k-1] hold level k; row-major, (dimension >> k) entries per row
+    std::vector<std::vector<cell_value_t>> minimums;
+    std::vector<std::vector<cell_value_t>> maximums;
+};
+
+} // namespace terrain::grid
+
+#endif // #ifndef _GRID_PYRAMID_HPP_
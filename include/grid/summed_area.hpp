@@ -0,0 +1,62 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _GRID_SUMMED_AREA_HPP_
+#define _GRID_SUMMED_AREA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+
+using terrain::geometry::cell_value_t;
+
+namespace terrain::grid {
+
+///! \brief summed-area table (integral image) of the blocked cells in a square grid
+///!
+///! Entry (i,j) holds the number of blocked cells in [0,i) x [0,j), so the count over any
+///! rectangle of cells takes four lookups.  Writes to the grid only mark rows as dirty; the
+///! table is brought up to date lazily, from the lowest dirty row upwards, on the next count.
+class SummedAreaTable {
+public:
+    ///! \param dimension - number of cells along each side of the source grid
+    SummedAreaTable(const size_t dimension);
+
+    ///! \brief recomputes the entire table from the given cells
+    void build(const std::vector<cell_value_t>& cells);
+
+    ///! \brief brings any dirty rows up to date, so that later counts only read the table
+    ///!
+    ///! `count` otherwise refreshes the table itself, which is not safe from concurrent readers.
+    void update(const std::vector<cell_value_t>& cells);
+
+    ///! \brief counts the blocked cells within the inclusive cell range [i0, i1] x [j0, j1]
+    size_t count(const std::vector<cell_value_t>& cells,
+                 const size_t i0, const size_t j0, const size_t i1, const size_t j1) const;
+
+    size_t get_memory_usage() const;
+
+    ///! \brief marks the given row of cells (and so every table row above it) as out of date
+    inline void invalidate(const size_t row){ if(row < dirty_row){ dirty_row = row; } }
+
+private:
+    ///! \brief recomputes the table rows covering cell rows [dirty_row, dimension).
+    ///! Rows are prefixed in parallel, then columns are accumulated in parallel.
+    void refresh(const std::vector<cell_value_t>& cells) const;
+
+private:
+    size_t dimension;
+    size_t stride;
+
+    // lowest cell row whose changes are not yet reflected in `table`;  == dimension when clean.
+    mutable size_t dirty_row;
+
+    // (dimension+1)^2 entries, row-major.  Row 0 and column 0 are always zero.
+    mutable std::vector<uint32_t> table;
+};
+
+} // namespace terrain::grid
+
+#endif // #ifndef _GRID_SUMMED_AREA_HPP_
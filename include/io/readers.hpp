@@ -57,6 +57,21 @@ inline geometry::Polygon make_polygons_from_OGRLine( const OGRLinearRing& source
 template<typename terrain_t>
 bool load_shape_from_file(terrain_t& terrain, const string& filepath);
 
+///! \brief loads the first band of a north-up raster (e.g. a GeoTIFF costmap) as cell values, one pixel per cell
+///!
+///! The layout comes from the raster's geotransform: its pixel size must already be a supported (power-of-2) precision.
+///! The raster is read in aligned windows, each written into the terrain as a block.
+template<typename terrain_t>
+bool load_raster_from_file(terrain_t& terrain, const string& filepath);
+
+///! \brief marks every cell holding a point higher than `height_threshold` as blocked
+///!
+///! Reads either a binary PCD file (with float x, y, z fields, among any others) or a headerless file of
+///! packed float32 (x, y, z) triplets.  The terrain's current layout is kept; points outside of it are ignored.
+///! Points are binned in parallel into one shared bitset of cells, before one batched store.
+template<typename terrain_t>
+bool load_points_from_file(terrain_t& terrain, const string& filepath, const double height_threshold);
+
 }; // namespace terrain::io
 
 #include "readers.inl"
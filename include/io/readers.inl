@@ -4,10 +4,17 @@
 // NOTE: This is the template-class implementation -- 
 //       It is not compiled until referenced, even though it contains the function implementations.
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -28,6 +35,7 @@ using std::string;
 #include "geometry/layout.hpp"
 #include "geometry/polygon.hpp"
 #include "terrain.hpp"
+#include "util/parallel.hpp"
 
 using Eigen::Vector2d;
 
@@ -266,3 +274,211 @@ bool terrain::io::load_shape_from_file(terrain_t& t, const string& filepath){
 #endif //#ifdef ENABLE_GDAL
 }
 
+
+template<typename terrain_t>
+bool terrain::io::load_raster_from_file(terrain_t& t, const string& filepath){
+#ifdef ENABLE_GDAL
+    auto * source_dataset = (GDALDataset*) GDALOpenEx( filepath.c_str(), GDAL_OF_RASTER, NULL, NULL, NULL );
+    if( source_dataset == NULL ){
+        t.error_message = "!> Open failed: " + filepath + '\n';
+        return false;
+    }
+
+    const size_t raster_width = source_dataset->GetRasterXSize();
+    const size_t raster_height = source_dataset->GetRasterYSize();
+    double geo_transform[6];
+    if( (1 > source_dataset->GetRasterCount()) || (CE_None != source_dataset->GetGeoTransform(geo_transform)) ){
+        t.error_message = "!> raster has no bands, or no geotransform: " + filepath + '\n';
+        GDALClose( source_dataset );
+        return false;
+    }
+
+    // only north-up rasters with square pixels map directly onto cells
+    const double precision = geo_transform[1];
+    if( (0 != geo_transform[2]) || (0 != geo_transform[4]) || (precision != -geo_transform[5]) ){
+        t.error_message = "!> raster is rotated, flipped, or has non-square pixels: " + filepath + '\n';
+        GDALClose( source_dataset );
+        return false;
+    }
+
+    // the layout is anchored at the raster's north-west corner; any extra area to the east or south is blocked
+    size_t dimension = 1;
+    while( dimension < std::max(raster_width, raster_height) ){
+        dimension <<= 1;
+    }
+    const double width = dimension * precision;
+    const Layout layout( precision, geo_transform[0] + width/2, geo_transform[3] - width/2, width);
+    if( (precision != layout.get_precision()) || (dimension != layout.get_dimension()) ){
+        t.error_message = "!> raster pixel size (" + std::to_string(precision) + ") is not a supported (power-of-2) precision.\n";
+        GDALClose( source_dataset );
+        return false;
+    }
+
+    t.reset( layout, block_value );
+
+    // read in aligned, square windows: each one covers a whole subtree, and (for tiled files) whole blocks
+    const size_t window_width = std::min<size_t>(256, dimension);
+    std::vector<cell_value_t> window( window_width * window_width );
+    GDALRasterBand* band = source_dataset->GetRasterBand(1);
+    for( size_t row = 0; row < raster_height; row += window_width ){
+        for( size_t column = 0; column < raster_width; column += window_width ){
+            const size_t read_width = std::min(window_width, raster_width - column);
+            const size_t read_height = std::min(window_width, raster_height - row);
+            if( (read_width < window_width) || (read_height < window_width) ){
+                std::fill( window.begin(), window.end(), block_value );
+            }
+
+            if( CE_None != band->RasterIO( GF_Read, column, row, read_width, read_height, window.data(),
+                                           read_width, read_height, GDT_Byte, 1, window_width) ){
+                t.error_message = "!> failed to read raster window at: (" + std::to_string(column) + ", " + std::to_string(row) + ")\n";
+                GDALClose( source_dataset );
+                return false;
+            }
+
+            // raster rows run north-to-south; cell rows run south-to-north
+            t.impl.store_block( column, dimension - row - window_width, window_width, window_width, window.data(), window_width);
+        }
+    }
+
+    GDALClose( source_dataset );
+    return true;
+
+#else //#ifdef ENABLE_GDAL
+    cerr << "GDAL functionality is disabled!! Could not load.\n";
+    return false;
+
+#endif //#ifdef ENABLE_GDAL
+}
+
+template<typename terrain_t>
+bool terrain::io::load_points_from_file(terrain_t& t, const string& filepath, const double height_threshold){
+    std::ifstream source(filepath, std::ios::binary);
+    if( ! source ){
+        t.error_message = "!> Open failed: " + filepath + '\n';
+        return false;
+    }
+
+    // describe each record: its size, and where the x, y, and z floats sit inside it
+    size_t point_step = 3 * sizeof(float);
+    size_t offsets[3] = {0, sizeof(float), 2*sizeof(float)};
+
+    std::string line;
+    std::getline(source, line);
+    if( (0 == line.rfind("# .PCD", 0)) || (0 == line.rfind("VERSION", 0)) ){
+        std::vector<std::string> fields;
+        std::vector<size_t> sizes;
+        std::vector<size_t> counts;
+        std::vector<char> types;
+        std::string data_format;
+        do {
+            std::istringstream tokens(line);
+            std::string key;
+            tokens >> key;
+            if( "FIELDS" == key ){
+                for( std::string field; tokens >> field; ){ fields.push_back(field); }
+            }else if( "SIZE" == key ){
+                for( size_t size; tokens >> size; ){ sizes.push_back(size); }
+            }else if( "TYPE" == key ){
+                for( char type; tokens >> type; ){ types.push_back(type); }
+            }else if( "COUNT" == key ){
+                for( size_t count; tokens >> count; ){ counts.push_back(count); }
+            }else if( "DATA" == key ){
+                tokens >> data_format;
+                break;
+            }
+        } while( std::getline(source, line) );
+
+        if( "binary" != data_format ){
+            t.error_message = "!> only binary PCD files are supported; found: '" + data_format + "'\n";
+            return false;
+        }
+        if( (fields.size() != sizes.size()) || (fields.size() != types.size()) ){
+            t.error_message = "!> malformed PCD header in: " + filepath + '\n';
+            return false;
+        }
+        counts.resize(fields.size(), 1);
+
+        const std::string axes[3] = {"x", "y", "z"};
+        size_t found = 0;
+        point_step = 0;
+        for( size_t field_index = 0; field_index < fields.size(); ++field_index ){
+            for( size_t axis = 0; axis < 3; ++axis ){
+                if( axes[axis] == fields[field_index] ){
+                    if( ('F' != types[field_index]) || (sizeof(float) != sizes[field_index]) ){
+                        t.error_message = "!> PCD field '" + axes[axis] + "' must be a 4-byte float.\n";
+                        return false;
+                    }
+                    offsets[axis] = point_step;
+                    ++found;
+                }
+            }
+            point_step += sizes[field_index] * counts[field_index];
+        }
+        if( 3 != found ){
+            t.error_message = "!> PCD file does not contain x, y, and z fields: " + filepath + '\n';
+            return false;
+        }
+    }else{
+        // headerless: packed float32 (x, y, z) triplets
+        source.clear();
+        source.seekg(0);
+    }
+
+    const Layout& layout = t.get_layout();
+    const size_t dimension = layout.get_dimension();
+    const double precision = layout.get_precision();
+    const double x_min = layout.get_x_min();
+    const double y_min = layout.get_y_min();
+
+    // one bitset of blocked cells, shared by all threads: a bit is only ever set, so a `fetch_or` needs no lock
+    const size_t word_count = (layout.get_size() + 63) / 64;
+    std::vector<std::atomic<uint64_t>> blocked(word_count);
+
+    const size_t chunk_points = 1 << 20;
+    std::vector<char> chunk( chunk_points * point_step );
+    while( source ){
+        source.read(chunk.data(), chunk.size());
+        const size_t point_count = static_cast<size_t>(source.gcount()) / point_step;
+
+        util::parallel_for( point_count, [&](const size_t point_begin, const size_t point_end){
+            for( size_t point = point_begin; point < point_end; ++point ){
+                const char* record = chunk.data() + point * point_step;
+                float xyz[3];
+                for( size_t axis = 0; axis < 3; ++axis ){
+                    memcpy( &xyz[axis], record + offsets[axis], sizeof(float));
+                }
+
+                // also rejects NaN heights, which some scanners emit for missing returns
+                if( !(height_threshold < xyz[2]) ){
+                    continue;
+                }
+                const double i = std::floor((xyz[0] - x_min) / precision);
+                const double j = std::floor((xyz[1] - y_min) / precision);
+                if( (i < 0) || (j < 0) || (dimension <= i) || (dimension <= j) ){
+                    continue;
+                }
+
+                const size_t cell = static_cast<size_t>(i) + static_cast<size_t>(j) * dimension;
+                const uint64_t bit = uint64_t(1) << (cell % 64);
+                std::atomic<uint64_t>& word = blocked[cell / 64];
+                // dense clouds land many points per cell; skip the read-modify-write once the bit is set
+                if( 0 == (word.load(std::memory_order_relaxed) & bit) ){
+                    word.fetch_or(bit, std::memory_order_relaxed);
+                }
+            }
+        }, 4096);
+    }
+
+    // each blocked cell is written exactly once, however many points landed in it
+    std::vector<Vector2d> points;
+    for( size_t word = 0; word < word_count; ++word ){
+        for( uint64_t bits = blocked[word].load(std::memory_order_relaxed); 0 != bits; bits &= (bits - 1) ){
+            const size_t cell = word * 64 + __builtin_ctzll(bits);
+            points.emplace_back( x_min + ((cell % dimension) + 0.5) * precision,
+                                 y_min + ((cell / dimension) + 0.5) * precision);
+        }
+    }
+    t.store_batch(points, std::vector<cell_value_t>(points.size(), block_value));
+
+    return true;
+}
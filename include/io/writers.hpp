@@ -35,6 +35,26 @@ bool to_png(const terrain_t& t, const std::string& filename);
 template<typename terrain_t>
 bool to_png(const terrain_t& t, FILE* dest);
 
+///! \brief writes the terrain as an XYZ-style pyramid of png tiles: `{directory}/{z}/{x}/{y}.png`
+///!
+///! Zoom 0 is a single tile covering the whole terrain; the finest zoom level shows one pixel per cell.
+///! Each coarser level keeps the largest value of each 2x2 block below it, so obstacles stay visible when zoomed out.
+///! The terrain is rasterized once; tiles are encoded and written in parallel.
+///!
+///! \param directory - root of the tile tree; created if needed
+///! \param tile_width - pixels along each side of a tile.  Must be a power of 2.
+template<typename terrain_t>
+bool to_tiles(const terrain_t& t, const std::string& directory, size_t tile_width = 256);
+
+#ifdef ENABLE_GDAL
+///! \brief writes a square, single-band byte image, whose rows are `stride` bytes apart, as a png file
+inline bool write_png(const geometry::cell_value_t* buffer, const size_t image_width, const size_t stride, const std::string& filepath);
+#endif
+
+///! \brief writes a single-band, byte-valued GeoTIFF file, georeferenced from the terrain's layout
+template<typename terrain_t>
+bool to_geotiff(const terrain_t& t, const std::string& filename);
+
 
 }; // namespace terrain::io
 
@@ -4,8 +4,12 @@
 // NOTE: This is the template-class implementation -- 
 //       It is not compiled until referenced, even though it contains the function implementations.
 
+#include <cmath>
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -26,8 +30,10 @@ using std::string;
 
 #include "geometry/layout.hpp"
 #include "geometry/polygon.hpp"
+#include "geometry/sample.hpp"
 #include "grid/grid.hpp"
 #include "terrain.hpp"
+#include "util/parallel.hpp"
 
 using Eigen::Vector2d;
 
@@ -63,18 +69,23 @@ bool terrain::io::to_json_grid(const terrain_t& t, nlohmann::json& grid ) {
     const double width_2 = layout.get_half_width();
     const double precision = layout.get_precision();
     const double prec_2 = precision/2;
+    const double x_min = layout.get_x_min();
 
+    std::vector<terrain::geometry::Run> runs;
     for(size_t yi=0; yi < dim; ++yi){
         const double y = ((dim-yi-1)*precision + prec_2 + center.y() - width_2);
         // cerr << "    @[" << yi << "] => (" << y << ")" << endl;
         if(grid[yi].is_null()){
             grid[yi] = nlohmann::json::array();
         }
-    
-        for(size_t xi=0; xi < dim; ++xi){
-            const double x = (xi * precision + prec_2 + center.x() - width_2);
-            grid[yi][xi] = t.classify({x,y});
-            // cerr << "        @[" << xi << ", " << yi << "] => (" << x << ", " << y << ") => " << static_cast<int>(value) << endl;
+
+        // one lookup per run of equal cells, rather than one per cell
+        t.scan_row(y, runs);
+        for( const auto& run : runs ){
+            const size_t xi_end = std::lround((run.x_end - x_min)/precision);
+            for(size_t xi = std::lround((run.x_begin - x_min)/precision); xi < xi_end; ++xi){
+                grid[yi][xi] = run.is;
+            }
         }
     }
 
@@ -82,11 +93,48 @@ bool terrain::io::to_json_grid(const terrain_t& t, nlohmann::json& grid ) {
 }
 
 template<typename terrain_t>
-bool terrain::io::to_png(const terrain_t& t, const string& filepath){
+bool terrain::io::to_geotiff(const terrain_t& t, const string& filepath){
 #ifdef ENABLE_GDAL
     const Layout& layout = t.get_layout();
     const size_t image_width = layout.get_dimension();
+    const double precision = layout.get_precision();
+
+    // the GTiff driver supports direct creation; no intermediate dataset needed
+    GDALDriver* p_tiff_driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    if( nullptr == p_tiff_driver ){
+        cerr << "!! GeoTIFF driver is not available!" << endl;
+        return false;
+    }
+    GDALDataset *p_tiff_dataset = p_tiff_driver->Create(filepath.c_str(), image_width, image_width, 1, GDT_Byte, nullptr);
+    if( nullptr == p_tiff_dataset ){
+        cerr << "!! error creating GeoTIFF dataset at: " << filepath << endl;
+        return false;
+    }
 
+    // north-up: origin at the north-west corner, rows step south
+    double geo_transform[6] = { layout.get_x_min(), precision, 0,
+                                layout.get_y_max(), 0, -precision };
+    p_tiff_dataset->SetGeoTransform(geo_transform);
+
+    std::vector<cell_value_t> buffer( image_width * image_width );
+    t.rasterize_into(buffer.data(), image_width);
+
+    auto p_gray_band = p_tiff_dataset->GetRasterBand(1);
+    p_gray_band->SetColorInterpretation(GCI_GrayIndex);
+    const bool success = (CE_None == p_gray_band->RasterIO(GF_Write, 0, 0, image_width, image_width, buffer.data(), image_width, image_width, GDT_Byte, 0, 0));
+
+    GDALClose( p_tiff_dataset );
+    return success;
+
+#else
+    cerr << "GDAL is disabled!! Could not save.\n";
+    return false;
+
+#endif //#ifdef ENABLE_GDAL
+}
+
+#ifdef ENABLE_GDAL
+inline bool terrain::io::write_png(const cell_value_t* buffer, const size_t image_width, const size_t stride, const string& filepath){
     // create the source dataset (load into this source dataset)
     GDALDriver* p_memory_driver = GetGDALDriverManager()->GetDriverByName("MEM");
     GDALDataset *p_grid_dataset = p_memory_driver->Create("", image_width, image_width, 1, GDT_Byte, nullptr);
@@ -103,20 +151,8 @@ bool terrain::io::to_png(const terrain_t& t, const string& filepath){
         return false;
     }
 
-    // allocate data buffers
-    const double precision = layout.get_precision();
-    std::vector<cell_value_t> buffer( image_width * image_width );
-
-    // // Loop through the rows of the image.
-    int i = image_width-1;
-    for( double y = layout.get_y_min() + precision/2; y < layout.get_y_max(); y += precision, --i ){
-        int j = 0;
-        for( double x = layout.get_x_min() + precision/2; x < layout.get_x_max(); x += precision, ++j ){
-            buffer[i*image_width + j] = t.classify({x,y});
-        }
-    }
-
-    if( CE_Failure == p_gray_band->RasterIO(GF_Write, 0, 0, image_width, image_width, buffer.data(), image_width, image_width, GDT_Byte, 0, 0)){
+    if( CE_Failure == p_gray_band->RasterIO(GF_Write, 0, 0, image_width, image_width, const_cast<cell_value_t*>(buffer),
+                                            image_width, image_width, GDT_Byte, 1, stride)){
         GDALClose( p_grid_dataset );
         return false;
     }
@@ -124,12 +160,26 @@ bool terrain::io::to_png(const terrain_t& t, const string& filepath){
     // Use the png driver to copy the source dataset
     GDALDriver* p_png_driver = GetGDALDriverManager()->GetDriverByName("PNG");
     GDALDataset *p_png_dataset = p_png_driver->CreateCopy(filepath.c_str(), p_grid_dataset, FALSE, nullptr, nullptr, nullptr);
-    if( nullptr != p_png_dataset ){
+    const bool success = (nullptr != p_png_dataset);
+    if( success ){
         GDALClose( p_png_dataset );
     }
     GDALClose( p_grid_dataset );
 
-    return true;
+    return success;
+}
+#endif //#ifdef ENABLE_GDAL
+
+template<typename terrain_t>
+bool terrain::io::to_png(const terrain_t& t, const string& filepath){
+#ifdef ENABLE_GDAL
+    const size_t image_width = t.get_layout().get_dimension();
+
+    // allocate data buffers
+    std::vector<cell_value_t> buffer( image_width * image_width );
+    t.rasterize_into(buffer.data(), image_width);
+
+    return write_png(buffer.data(), image_width, image_width, filepath);
 
 #else
     cerr << "libpng is disabled!! Could not save.\n";
@@ -138,3 +188,84 @@ bool terrain::io::to_png(const terrain_t& t, const string& filepath){
 #endif //#ifdef ENABLE_LIBPNG
 }
 
+template<typename terrain_t>
+bool terrain::io::to_tiles(const terrain_t& t, const string& directory, size_t tile_width){
+#ifdef ENABLE_GDAL
+    const size_t dimension = t.get_layout().get_dimension();
+    tile_width = std::min(tile_width, dimension);
+    if( (0 == tile_width) || (0 != (tile_width & (tile_width - 1))) ){
+        cerr << "!! tile width must be a power of 2; got: " << tile_width << endl;
+        return false;
+    }
+
+    // zoom 0 is a single tile covering the whole terrain; the finest zoom shows one pixel per cell
+    size_t max_zoom = 0;
+    while( (tile_width << max_zoom) < dimension ){
+        ++max_zoom;
+    }
+
+    // levels[z] is the whole terrain as one image, (tile_width << z) pixels wide
+    std::vector<std::vector<cell_value_t>> levels(max_zoom + 1);
+    levels[max_zoom].resize( dimension * dimension );
+    t.rasterize_into(levels[max_zoom].data(), dimension);
+
+    // coarser levels keep the largest value of each 2x2 block, so no obstacle disappears when zoomed out
+    for( size_t zoom = max_zoom; 0 < zoom; --zoom ){
+        const size_t source_width = tile_width << zoom;
+        const size_t level_width = source_width >> 1;
+        const cell_value_t* source = levels[zoom].data();
+        levels[zoom-1].resize( level_width * level_width );
+        cell_value_t* level = levels[zoom-1].data();
+
+        util::parallel_for( level_width, [&](const size_t row_begin, const size_t row_end){
+            for( size_t row = row_begin; row < row_end; ++row ){
+                const cell_value_t* upper = source + (2*row) * source_width;
+                const cell_value_t* lower = upper + source_width;
+                for( size_t column = 0; column < level_width; ++column ){
+                    level[row*level_width + column] = std::max( std::max(upper[2*column], upper[2*column+1]),
+                                                                std::max(lower[2*column], lower[2*column+1]));
+                }
+            }
+        }, 16);
+    }
+
+    // layout on disk: {directory}/{z}/{x}/{y}.png, with y = 0 at the northern edge
+    std::error_code error;
+    std::vector<size_t> first_tile(max_zoom + 2, 0);
+    for( size_t zoom = 0; zoom <= max_zoom; ++zoom ){
+        const size_t tiles_per_side = size_t(1) << zoom;
+        first_tile[zoom + 1] = first_tile[zoom] + tiles_per_side * tiles_per_side;
+        for( size_t x = 0; x < tiles_per_side; ++x ){
+            const auto path = std::filesystem::path(directory) / std::to_string(zoom) / std::to_string(x);
+            if( ! std::filesystem::create_directories(path, error) && error ){
+                cerr << "!! could not create tile directory: " << path << " : " << error.message() << endl;
+                return false;
+            }
+        }
+    }
+
+    std::atomic<bool> success(true);
+    util::parallel_for( first_tile[max_zoom + 1], [&](const size_t tile_begin, const size_t tile_end){
+        for( size_t tile = tile_begin; tile < tile_end; ++tile ){
+            const size_t zoom = std::upper_bound(first_tile.begin(), first_tile.end(), tile) - first_tile.begin() - 1;
+            const size_t tiles_per_side = size_t(1) << zoom;
+            const size_t x = (tile - first_tile[zoom]) % tiles_per_side;
+            const size_t y = (tile - first_tile[zoom]) / tiles_per_side;
+
+            const size_t level_width = tile_width << zoom;
+            const cell_value_t* corner = levels[zoom].data() + (y * tile_width) * level_width + x * tile_width;
+            const auto path = std::filesystem::path(directory) / std::to_string(zoom) / std::to_string(x) / (std::to_string(y) + ".png");
+            if( ! write_png(corner, tile_width, level_width, path.string()) ){
+                success = false;
+            }
+        }
+    });
+
+    return success;
+
+#else
+    cerr << "GDAL is disabled!! Could not save tiles.\n";
+    return false;
+
+#endif //#ifdef ENABLE_GDAL
+}
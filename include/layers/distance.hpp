@@ -0,0 +1,31 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _LAYERS_DISTANCE_HPP_
+#define _LAYERS_DISTANCE_HPP_
+
+#include "grid/grid.hpp"
+#include "layers/layer.hpp"
+#include "quadtree/tree.hpp"
+
+namespace terrain::layers {
+
+///! \brief exact Euclidean distance, from each cell's center to the center of the nearest blocked cell
+///!
+///! Distances are in layout units (i.e. cell-count * precision); blocked cells read 0.  As with `classify`,
+///! everything outside of the layout counts as blocked, so distances never exceed the distance to the border.
+///!
+///! Runs in linear time: a 1D pass along every row, then the lower-envelope transform of Felzenszwalb & Huttenlocher
+///! ("Distance Transforms of Sampled Functions", 2012) down every column.  Rows, then columns, run in parallel.
+Layer<float> distance_transform(const grid::Grid& terrain);
+
+///! \brief as above; the row pass reads whole runs of leaves at once (via `scan_row`), instead of every cell
+///!
+///! Only the reading is leaf-granular.  The output layer is dense, so the row pass still writes every cell of each
+///! run, and the column pass is the same per-cell pass as for a grid: this is O(dimension^2), however few leaves
+///! the tree has.  It saves the per-cell descents of reading a tree cell by cell, not the per-cell work itself.
+Layer<float> distance_transform(const quadtree::Tree& terrain);
+
+} // namespace terrain::layers
+
+#endif // #ifndef _LAYERS_DISTANCE_HPP_
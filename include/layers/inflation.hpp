@@ -0,0 +1,44 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _LAYERS_INFLATION_HPP_
+#define _LAYERS_INFLATION_HPP_
+
+#include "geometry/cell_value.hpp"
+#include "grid/grid.hpp"
+#include "layers/layer.hpp"
+#include "quadtree/tree.hpp"
+
+namespace terrain::layers {
+
+using terrain::geometry::cell_value_t;
+
+///! cost of a blocked cell
+constexpr cell_value_t cost_lethal = 0xFF;
+///! cost of a cell within `radius` of a blocked cell: i.e. the robot's footprint would touch the obstacle
+constexpr cell_value_t cost_inscribed = 0xFE;
+
+///! \brief inflates the blocked cells of a terrain into a cost layer, for a robot of the given radius
+///!
+///! Blocked cells cost `cost_lethal`; cells within `radius` of them cost `cost_inscribed`; beyond that, the cost
+///! decays as `(cost_inscribed - 1) * exp(-decay * (distance - radius))`, down to 0.
+///!
+///! Works from the exact distance transform, so the falloff is round (rather than square, as from a separable
+///! max-filter) and costs nothing more for a larger radius.  Every cell near an obstacle is then one table lookup;
+///! for a slow falloff, more distant cells compute their cost directly, so the table stays small.
+///!
+///! \param distances - as from `distance_transform`
+///! \param radius - inscribed radius of the robot, in layout units.  Must not be negative.
+///! \param decay - rate of the falloff, per layout unit.  Must be positive.
+///! Throws `std::invalid_argument` if either is out of range.
+Layer<cell_value_t> inflate(const Layer<float>& distances, const double radius, const double decay);
+
+///! \brief as above, from the terrain's own distance transform
+Layer<cell_value_t> inflate(const grid::Grid& terrain, const double radius, const double decay);
+
+///! \brief as above; the tree's distance transform works a run of leaves at a time
+Layer<cell_value_t> inflate(const quadtree::Tree& terrain, const double radius, const double decay);
+
+} // namespace terrain::layers
+
+#endif // #ifndef _LAYERS_INFLATION_HPP_
@@ -0,0 +1,58 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _LAYERS_LAYER_HPP_
+#define _LAYERS_LAYER_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "geometry/layout.hpp"
+
+namespace terrain::layers {
+
+///! \brief a dense, per-cell layer of derived data (e.g. clearance, or cost), kept alongside a terrain
+///!
+///! Shares the terrain's layout, and its storage order: row-major, from the south-west corner.
+template<typename value_t>
+class Layer {
+public:
+    Layer(const geometry::Layout& _layout, const value_t fill_value)
+        : layout(_layout), storage(_layout.get_size(), fill_value)
+    {}
+
+    ///! \brief the value of the cell containing `p`; or `outside` if `p` is not within the layer
+    value_t classify(const Eigen::Vector2d& p, const value_t outside) const {
+        if( ! layout.contains(p) ){
+            return outside;
+        }
+        // the northern / eastern borders belong to the last row / column
+        const size_t last = layout.get_dimension() - 1;
+        const size_t i = std::min(last, static_cast<size_t>((p.x() - layout.get_x_min()) / layout.get_precision()));
+        const size_t j = std::min(last, static_cast<size_t>((p.y() - layout.get_y_min()) / layout.get_precision()));
+        return get_cell(i, j);
+    }
+
+    inline value_t* data() { return storage.data(); }
+    inline const value_t* data() const { return storage.data(); }
+
+    ///! \warning !! DOES NOT CHECK BOUNDS !!
+    inline value_t& get_cell(const size_t i, const size_t j) { return storage[i + j * layout.get_dimension()]; }
+    inline value_t get_cell(const size_t i, const size_t j) const { return storage[i + j * layout.get_dimension()]; }
+
+    inline const geometry::Layout& get_layout() const { return layout; }
+
+    inline size_t get_memory_usage() const { return storage.size() * sizeof(value_t); }
+
+private:
+    geometry::Layout layout;
+
+    std::vector<value_t> storage;
+};
+
+} // namespace terrain::layers
+
+#endif // #ifndef _LAYERS_LAYER_HPP_
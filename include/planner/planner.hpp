@@ -0,0 +1,110 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _PLANNER_PLANNER_HPP_
+#define _PLANNER_PLANNER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "grid/grid.hpp"
+#include "quadtree/leaf_graph.hpp"
+#include "quadtree/tree.hpp"
+#include "terrain.hpp"
+
+namespace terrain::planner {
+
+///! \brief a planned route, from start to goal
+struct Path {
+    ///! the start, the center of each cell (or leaf) passed through, then the goal.  Empty if there is no path.
+    ///! The start's and goal's own cells (or leaves) count as passed through, unless they are one and the same;
+    ///! so each segment either stays inside one cell, or steps across the border two cells share.
+    std::vector<Eigen::Vector2d> waypoints;
+
+    ///! length of the polyline through `waypoints`, in layout units; infinite if there is no path
+    double length = std::numeric_limits<double>::infinity();
+
+    inline bool found() const { return ! waypoints.empty(); }
+};
+
+///! \brief scratch space for searches: kept between queries, so that repeated searches do not allocate.
+///!
+///! Per-node state is tagged with the generation of the search that wrote it; starting a new search
+///! only bumps the generation, so stale state from earlier searches is ignored instead of cleared.
+class Workspace {
+public:
+    ///! \brief readies the workspace for a search over `node_count` nodes.  Grows the arrays only if needed.
+    void begin(const size_t node_count);
+
+    ///! \brief whether `node` has been reached during the current search
+    inline bool reached(const uint32_t node) const { return generation == stamps[node]; }
+
+    size_t get_memory_usage() const;
+
+public:
+    struct Entry {
+        double priority;
+        double cost;
+        uint32_t node;
+
+        // orders a max-heap as a min-heap
+        inline bool operator<(const Entry& other) const { return other.priority < priority; }
+    };
+
+    // per node: cost from the start, and the node it was reached from.  Valid only where `reached`.
+    std::vector<double> costs;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> stamps;
+
+    // the open set: a binary heap in a flat array
+    std::vector<Entry> open;
+
+    uint32_t generation = 0;
+};
+
+///! \brief A* across the free cells of a grid, 8-connected.
+///!
+///! Diagonal steps may not cut the corner of a blocked cell.  Steps cost their length, and the heuristic is the
+///! octile distance, so the path found is a shortest one (through cell centers).
+///!
+///! \param start, goal - the path's ends.  No path is found if either is outside the grid, or in a blocked cell.
+///! \param workspace - scratch space; reuse it between calls
+Path plan(const grid::Grid& grid, const Eigen::Vector2d& start, const Eigen::Vector2d& goal, Workspace& workspace);
+
+///! \brief A* across the free leaves of a tree; i.e. the nodes of its `LeafGraph`.
+///!
+///! Steps run between leaf centers, so large open leaves are crossed in a single step.  Paths are thus far
+///! cheaper to find than on a grid, though not always the shortest possible.
+///!
+///! \param graph - as built from this tree, since its last write
+Path plan(const quadtree::Tree& tree, const quadtree::LeafGraph& graph,
+          const Eigen::Vector2d& start, const Eigen::Vector2d& goal, Workspace& workspace);
+
+///! \brief plans from one start to each of several goals; the searches run in parallel, each with its own workspace
+std::vector<Path> plan(const grid::Grid& grid, const Eigen::Vector2d& start, const std::vector<Eigen::Vector2d>& goals);
+
+///! \brief as above, across the free leaves of a tree
+std::vector<Path> plan(const quadtree::Tree& tree, const quadtree::LeafGraph& graph,
+                       const Eigen::Vector2d& start, const std::vector<Eigen::Vector2d>& goals);
+
+///! \brief plans across a grid terrain
+inline Path plan(const Terrain<grid::Grid>& terrain, const Eigen::Vector2d& start, const Eigen::Vector2d& goal,
+                 Workspace& workspace)
+{
+    return plan(terrain.impl, start, goal, workspace);
+}
+
+///! \brief plans across a tree terrain.  Builds the leaf graph each call: to plan repeatedly, keep a `LeafGraph`.
+inline Path plan(const Terrain<quadtree::Tree>& terrain, const Eigen::Vector2d& start, const Eigen::Vector2d& goal,
+                 Workspace& workspace)
+{
+    return plan(terrain.impl, quadtree::LeafGraph(terrain.impl), start, goal, workspace);
+}
+
+} // namespace terrain::planner
+
+#endif // #ifndef _PLANNER_PLANNER_HPP_
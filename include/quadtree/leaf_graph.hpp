@@ -0,0 +1,59 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _QUADTREE_LEAF_GRAPH_HPP_
+#define _QUADTREE_LEAF_GRAPH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "quadtree/tree.hpp"
+
+namespace terrain::quadtree {
+
+///! \brief adjacency graph of the free leaves of a tree, in compressed-sparse-row form
+///!
+///! Nodes are the free (i.e. not `is_blocked`) leaves, numbered in Morton order; two nodes are joined if their
+///! leaves share a stretch of border.  The edges of node `n` are `targets[offsets[n]]` through
+///! `targets[offsets[n+1] - 1]`, so a traversal reads each node's edges contiguously.
+///!
+///! The graph is a snapshot: it does not follow later writes to the tree.
+class LeafGraph {
+public:
+    ///! \brief builds the graph from the tree's current leaves; nodes and edges are each found in parallel
+    ///!
+    ///! Best run on a pruned tree (e.g. after `prune`, or the merging writes): fewer, larger leaves make a smaller graph.
+    LeafGraph(const Tree& tree);
+
+    ///! \brief index of the node for `leaf` (by binary search of the sorted codes); or `npos` if it is not a node
+    size_t find(const Leaf& leaf) const;
+
+    inline size_t size() const { return leaves.size(); }
+
+    inline size_t edge_count() const { return targets.size(); }
+
+    size_t get_memory_usage() const;
+
+public:
+    constexpr static size_t npos = std::numeric_limits<size_t>::max();
+
+    ///! per node: the leaf itself, its center, and its width
+    std::vector<Leaf> leaves;
+    std::vector<Eigen::Vector2d> centers;
+    std::vector<double> widths;
+
+    ///! per node: where its edges start.  One longer than the node count.
+    std::vector<uint32_t> offsets;
+
+    ///! per edge: the node at the far end, and the length of border the two leaves share
+    std::vector<uint32_t> targets;
+    std::vector<double> border_lengths;
+};
+
+} // namespace terrain::quadtree
+
+#endif // #ifndef _QUADTREE_LEAF_GRAPH_HPP_
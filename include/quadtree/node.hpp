@@ -4,6 +4,7 @@
 #ifndef _QUADTREE_NODE_HPP_
 #define _QUADTREE_NODE_HPP_
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -24,57 +25,142 @@ public:
     Node();
     Node(const cell_value_t value);
 
+    ///! \brief copy-on-write copy: shares the children of `other`, in O(1)
+    ///!
+    ///! Both nodes keep reading the same subtree; whichever is written beneath first makes its own copy of
+    ///! the child block on the way down (see `split()`), so untouched subtrees stay shared.
+    ///! Marks the children of `other` as shared, too; so `other` must not be written to meanwhile.
+    Node(const Node& other);
+
+    ///! \brief turns this node into a copy-on-write copy of `other`, as the copy constructor; releases its own children
+    Node& operator=(const Node& other);
+
     ~Node();
 
+    ///! \brief deduplicates structurally identical subtrees beneath this node, turning the tree into a DAG
+    ///!
+    ///! Walks the children bottom-up, and interns each block of four siblings in a hash table keyed on the
+    ///! siblings' leaf values and (already interned) child blocks; equal blocks are then shared.  Reads are
+    ///! unaffected, and a later write copies any shared block on its path (see `split()`).
+    ///! Requires exclusive access, as `prune()`.
+    void compact();
+
     void draw(std::ostream& sink, const std::string& prefix, const std::string& as, const bool show_pointers) const;
 
+    ///! \brief turns this node into a single leaf holding `fill_value`, dropping any children
     void fill(const cell_value_t fill_value);
 
     size_t get_count() const;
     size_t get_height() const;
 
+    ///! \brief number of distinct nodes at or beneath this node: blocks shared within the subtree count once
+    size_t get_unique_count() const;
+
+    ///! \brief bytes held by this node and by the distinct blocks of children beneath it
+    size_t get_memory_usage() const;
+
     Node* get(Node::Quadrant quad) const;
     Node* get_northeast() const;
     Node* get_northwest() const;
     Node* get_southeast() const;
     Node* get_southwest() const;
 
-    cell_value_t& get_value();
     cell_value_t get_value() const;
 
+    ///! \brief smallest value of any leaf at or beneath this node
+    inline cell_value_t get_minimum() const { return minimum.load(std::memory_order_relaxed); }
+    ///! \brief largest value of any leaf at or beneath this node
+    inline cell_value_t get_maximum() const { return maximum.load(std::memory_order_relaxed); }
+
     bool load(const nlohmann::json& doc);
 
     bool operator==(const Node& other) const;
 
     ///! \brief coalesce groups of leaf nodes with identice values (for some value of "identical")
+    ///!
+    ///! Only splits the blocks above a subtree that actually collapses (see `split()`); blocks shared with other
+    ///! versions, or by `compact()`, are otherwise left alone.  Requires exclusive access.
     void prune();
 
+    ///! \brief prepares this node's children for writing
+    ///!
+    ///! Splits a leaf into four children, each holding this leaf's value.  On a non-leaf whose children are
+    ///! marked as shared (by a copy of this node, or by `compact()`), copies the child block, which in turn
+    ///! shares the grandchildren; unless no other node references the block any more.  Otherwise a no-op.
+    ///! Afterwards, the children belong to this node alone.
+    ///!
+    ///! Safe to race against other calls to `split()` on the same node.  A new leaf's block is installed with a
+    ///! compare-and-swap, and the losing thread discards its own block.  A shared block is copied by whichever
+    ///! thread claims it first; the others wait for that copy, and never read the shared block themselves.
+    ///! So other versions may be dropped meanwhile (see `Tree::store`).
+    void split();
+
     void split(const double precision, const double width);
 
+    ///! \brief discards any children, turning this node back into a leaf
     void reset();
 
     bool is_leaf() const;
 
     void set_value(cell_value_t new_value);
 
+    ///! \brief recomputes this node's min/max summary from its immediate children
+    ///! \return whether the summary changed
+    bool update_summary();
+
+    ///! \brief as `update_summary()`, but safe while other threads write to leaves beneath this node
+    ///!
+    ///! Re-reads the children after publishing the summary, and repeats until they agree; so whichever writer
+    ///! finishes last leaves an exact summary behind.
+    ///! \return whether the summary changed
+    bool update_summary_concurrent();
+
     nlohmann::json to_json() const;
 
     std::string to_string() const;
 
 private:
-    void split();
-
-private:
-    // By design, any given node will only cantain (a) children or (b) a value.
-    // => If the following uptr, `northeast` has a value, the union will contain pointers.
-    // => if 'northeast' is empty / null => the union contains leaf-node-values
-    // defined in CCW order:  NE -> NW -> SW -> SE
-    std::unique_ptr<Node> northeast; //ne;
-    std::unique_ptr<Node> northwest; //nw;
-    std::unique_ptr<Node> southwest; //sw;
-    std::unique_ptr<Node> southeast; //se;
-
-    cell_value_t value;
+    // a reference-counted block of four sibling nodes
+    struct Block;
+
+    // drops one reference to `block`, and frees it with the last one
+    static void release(Block* block);
+
+    // hash table of blocks already interned by `compact()`
+    struct Interner;
+    static void compact(Node& node, Interner& interner);
+
+    // tag bits of `children`, below the (8-byte aligned) block address:
+    //   `owned_tag`   - the block belongs to this node alone, and may be written through
+    //   `copying_tag` - a writer has claimed the (shared) block, and is copying it; other writers wait
+    static constexpr uintptr_t owned_tag = 1;
+    static constexpr uintptr_t copying_tag = 2;
+    static constexpr uintptr_t tag_mask = owned_tag | copying_tag;
+
+    inline static Block* block_of(const uintptr_t word){ return reinterpret_cast<Block*>(word & ~tag_mask); }
+    inline Block* get_block() const { return block_of(children.load(std::memory_order_acquire)); }
+
+    // By design, any given node will only contain (a) children or (b) a value.
+    // => if `children` is set, it points to a block of four nodes, in CCW order:  NE -> NW -> SW -> SE
+    // => if `children` is null, this is a leaf, and `value` holds its value
+    //
+    // A block may be shared between copies of a node (i.e. between versions of a tree), and is only written
+    // through while tagged as owned.  Ownership is a property of the referencing node, not of the block's
+    // reference count: a writer never has to read a block that another version may be dropping.  (Ownership
+    // is only trusted along a path of owned blocks from the root; writers always descend from the root.)
+    // Copying a node clears the tags on both sides, hence `mutable`.
+    //
+    // New blocks are installed by compare-and-swap, so concurrent writers descending through the same node
+    // agree on its children.  Removing children (`reset`, `prune`, ...) is not synchronized, and requires
+    // exclusive access.
+    mutable std::atomic<uintptr_t> children;
+
+    std::atomic<cell_value_t> value;
+
+    // summary of the leaves beneath this node.  (For a leaf, both equal `value`.)
+    // These fit into the padding after `value`, so they do not grow the node.
+    std::atomic<cell_value_t> minimum;
+    std::atomic<cell_value_t> maximum;
 
 private:
     friend class NodeTest_ConstructDefault_Test;
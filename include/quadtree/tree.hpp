@@ -7,16 +7,21 @@
 #define QUAD_TREE_VERSION "0.0.1"
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <Eigen/Geometry>
 
 #include <nlohmann/json/json_fwd.hpp>
 
 #include "geometry/cell_value.hpp"
+#include "geometry/interpolate.hpp"
 #include "geometry/layout.hpp"
 #include "geometry/sample.hpp"
 
@@ -28,6 +33,28 @@ using namespace terrain::geometry;
 
 namespace terrain::quadtree {
 
+///! \brief names a single leaf of a tree, by its locational code
+///!
+///! `code` is the Morton key (as from `Layout::zhash`) of the leaf's south-west cell, and the leaf spans
+///! `dimension >> depth` cells on a side.  A leaf's key bits below its own level are always zero.
+///! Codes are only valid until the tree's structure next changes (i.e. a write that splits or merges).
+struct Leaf {
+    uint64_t code;
+    uint8_t depth;
+
+    inline bool operator==(const Leaf& other) const { return (code == other.code) && (depth == other.depth); }
+};
+
+///! \brief the sides of a leaf, for `Tree::neighbors`
+enum class Direction : uint8_t { North, East, South, West };
+
+///! \brief how `Tree::overlay` combines the values of two trees, cell by cell
+enum class Combine : uint8_t {
+    Union,          ///< the larger value: blocked where either is blocked
+    Intersection,   ///< the smaller value: blocked only where both are blocked
+    Overlay         ///< the second tree's value where it is blocked; otherwise the first tree's
+};
+
 /**
  * Datastructure: A point Quad Tree for representing 2D data. Each
  * region has the same ratio as the bounds for the tree.
@@ -52,13 +79,42 @@ public:
      */
     Tree(const Layout& _layout);
 
+    ///! \brief copy-on-write copy: a new version of `other`, in O(1)
+    ///!
+    ///! The two versions share every node until one of them is written to; a write then copies only the
+    ///! blocks along its root-to-leaf path, and keeps sharing every subtree it does not touch.  So a history of
+    ///! versions costs O(changes x height) memory per version.
+    ///!
+    ///! Versions may be read from any thread, and dropped at any time (e.g. `Terrain::snapshot` holders).
+    ///! Copying marks `other`'s nodes as shared, so `other` must not be written to while it is copied.
+    Tree(const Tree& other);
+
+    ///! \brief replaces this tree with a copy-on-write copy of `other`, as the copy constructor
+    Tree& operator=(const Tree& other);
+
     /**
      *  Releases all memory associated with this quad tree.
      */
     ~Tree();
 
+    ///! \brief splits leaves until the tree is 2:1 balanced: no leaf borders one more than one level deeper than itself
+    ///!
+    ///! Each leaf then has at most two neighbors per side (see `neighbors`).  Values are unchanged; only the
+    ///! structure is refined.  Note that later writes may merge equal siblings, and so unbalance the tree again.
+    void balance();
+
     static size_t calculate_complete_tree(const size_t height);
 
+    ///! \brief merges two trees with the same layout, by recursing through both in lock-step
+    ///!
+    ///! Wherever one side's min/max summary decides the result alone (e.g. for a union, a uniform blocked leaf of
+    ///! either tree, or an area of `a` whose smallest value bounds all of `b` there), that subtree is taken as a
+    ///! copy-on-write copy, without visiting what lies beneath it.  Equal sibling leaves are merged as the result
+    ///! is built, so it comes out pruned.  Runs in time proportional to the leaves visited, not to dimension^2.
+    ///! The result shares nodes with `a` and `b`; see the copy constructor.
+    ///! Throws `std::invalid_argument` unless both trees have the same layout.
+    static Tree overlay(const Tree& a, const Tree& b, const Combine op);
+
     /**
      * Returns true if the point at (x, y) exists in the tree.
      *
@@ -86,15 +142,38 @@ public:
      */
     void debug_tree(const bool show_pointer=false) const;
 
+    ///! \brief Walks the segment `from` -> `to`, leaf by leaf, and returns the first leaf whose value satisfies `predicate`
+    ///!
+    ///! Each step jumps across an entire leaf, so crossing a large uniform leaf costs a single descent.
+    ///! The segment is clipped to this tree first.
+    ///!
+    ///! \param from - start of the segment
+    ///! \param to - end of the segment
+    ///! \param predicate - test for a 'hit', e.g. `is_blocked`
+    ///! \return the point where the segment enters the hit leaf, and that leaf's value; or nothing, if no leaf matched.
+    std::optional<Sample> first_hit(const Eigen::Vector2d& from, const Eigen::Vector2d& to,
+                                    const std::function<bool(cell_value_t)>& predicate) const;
+
     /**
      * Gets the value of the point at (x, y).  If the point is not close to the center of a node, this function interpolates or extrapolates an appropriate value.
      *
+     * Interpolates bilinearly between the center of the leaf containing the point, and the three points one
+     * leaf-width over from it, towards the query point.  The path down to that leaf is kept, so the other three
+     * lookups each start from the lowest node they share with it, rather than from the root.  The weights are
+     * those of `interpolate_bilinear` (see `BilinearCorners`).
+     *
      * @param {double} x The x-coordinate.
      * @param {double} y The y-coordinate.
-     * @return {cell_value_t} The resultant value
+     * @return {cell_value_t} The resultant value; or the default value, outside of the tree
      */
     cell_value_t interp(const Eigen::Vector2d& at) const;
 
+    ///! \brief interpolates at many points; `values[n]` is `interp(points[n])`.
+    ///!
+    ///! Blocks of points gather their four samples (each with the same shared descent) in parallel; then the batch
+    ///! `interpolate_bilinear` kernel blends them all.
+    void interp(const std::vector<Eigen::Vector2d>& points, std::vector<cell_value_t>& values) const;
+
     ///! \brief sets all leaf nodes to the given value
     ///! \param fill_value - value to write
     void fill(const cell_value_t fill_value);
@@ -107,10 +186,15 @@ public:
     ///!
     inline const Layout& get_layout() const { return layout; }
 
+    ///! \brief the root node, for read-only walks over the tree's structure (e.g. diffs)
+    inline const Node& get_root() const { return *root; }
+
     size_t get_height() const;
     
+    ///! \brief distinct nodes, as a fraction of a complete tree of the same height.  Shared subtrees count once.
     double get_load_factor() const;
     
+    ///! \brief bytes held by the distinct nodes of this tree.  Subtrees shared by `compact()` count once.
     size_t get_memory_usage() const;
 
     /**
@@ -130,6 +214,54 @@ public:
     bool load_tree(const nlohmann::json& tree);
 
     void prune();
+
+    ///! \brief shares structurally identical subtrees (e.g. repeated footprints or tiles), turning the tree into a DAG
+    ///!
+    ///! Complements `prune()`: pruning merges uniform areas, compaction shares repeated, non-uniform ones.
+    ///! Reads are unaffected; a later write copies only the shared nodes on its own path.
+    ///! Needs exclusive access to this tree, and to any version that still shares nodes with it.
+    void compact();
+
+    ///! \brief Lists the leaves whose values satisfy `predicate` (e.g. `is_blocked`), in Morton order: i.e. sorted by code
+    ///!
+    ///! \param found - output; cleared first
+    void leaves(const std::function<bool(cell_value_t)>& predicate, std::vector<Leaf>& found) const;
+
+    ///! \brief Finds the leaf containing `p`.  The point must lie inside the tree.
+    ///!
+    ///! A point on a border belongs to the leaf to its west / south, as with `classify`.
+    Leaf locate(const Eigen::Vector2d& p) const;
+
+    ///! \brief Lists the leaves across the given side of `leaf`, which share a stretch of that side with it.
+    ///!
+    ///! The same-size neighbor is found by locational-code arithmetic on the leaf's Morton code (after Samet,
+    ///! "Neighbor finding in images represented by octrees", 1989), then a single descent towards it: either
+    ///! that descent ends at one leaf as large as, or larger than `leaf`; or it ends at a subtree, whose leaves
+    ///! along the facing side are all neighbors.
+    ///!
+    ///! \param leaf - as from `locate`
+    ///! \param direction - which side of `leaf` to look across
+    ///! \param found - output; cleared first.  Ordered west-to-east (north or south) or south-to-north (east or west).
+    ///!                Empty if that side is the border of the tree.
+    void neighbors(const Leaf& leaf, const Direction direction, std::vector<Leaf>& found) const;
+
+    ///! \brief Summarizes every cell overlapping the axis-aligned box [min, max)
+    ///!
+    ///! Descends only until a node lies entirely inside the box, then answers from that node's min/max summary;
+    ///! parts of the box outside of the tree read as the default value.
+    ///!
+    ///! \param min - lower-left corner of the box
+    ///! \param max - upper-right corner of the box
+    ///! \return whether the box is entirely free, entirely blocked, or mixed
+    Occupancy query_box(const Eigen::Vector2d& min, const Eigen::Vector2d& max) const;
+
+    ///! \brief Paints every cell of this tree into an image buffer, north-up: row 0 is the northernmost row of cells.
+    ///!
+    ///! Each leaf fills its whole rectangle at once, so no per-pixel descent is needed.
+    ///!
+    ///! \param buffer - destination; must hold at least `dimension` rows of `stride` bytes
+    ///! \param stride - distance, in bytes, between the starts of successive rows.  At least `dimension`.
+    void rasterize_into(cell_value_t* buffer, const size_t stride) const;
     
     void reset();
 
@@ -139,13 +271,46 @@ public:
     ///! \param precision - describe the bounds to at least this precision
     void reset(const Layout& new_layout);
 
+    ///! \brief resets the tree to a single leaf over the new layout, holding `fill_value`
+    ///!
+    ///! Unlike `reset(layout)`, this allocates nothing per-cell; later writes split leaves only where needed.
+    void reset(const Layout& new_layout, const cell_value_t fill_value);
+
+    ///! \brief Updates log-odds occupancy from one sensor scan: a ray from `origin` to each endpoint
+    ///!
+    ///! Each cell a ray passes through is nudged towards 'free' (`log_odds_miss`), and the cell where it ends,
+    ///! if inside the tree, towards 'occupied' (`log_odds_hit`); values saturate (see `update_log_odds`).
+    ///! All the updates of a scan are Morton-sorted and applied in one depth-first pass.  Leaves that the
+    ///! updates cannot change (e.g. already-saturated free space) are skipped whole; other leaves are split
+    ///! down to the updated cells, and equal siblings merged back on the way up.
+    ///! Start from `reset(layout, log_odds_unknown)`, and `threshold` the result for the blocked / free queries.
+    void integrate_scan(const Eigen::Vector2d& origin, const std::vector<Eigen::Vector2d>& endpoints);
+
+    ///! \brief turns this tree into a mask: 0xFF wherever a cell is at least `level`, and 0 elsewhere
+    ///!
+    ///! e.g. at `log_odds_occupied`, to read an occupancy tree (see `integrate_scan`) as blocked / free.
+    ///! Subtrees whose min/max summary lies wholly on one side of `level` become single leaves, without
+    ///! visiting anything beneath them; so this runs in time proportional to the leaves straddling `level`.
+    void threshold(const cell_value_t level);
+
     ///! \brief Classify what value the requested point `p` has.
     ///!
     ///! This method is designed for use with an interpolation algorithm.
     ///! 
     ///! \param location to sample near
-    ///! @return the point-value-pair _actually_ contained in the tree.
+    ///! @return the point-value-pair _actually_ contained in the tree: the center, value and width of the answering leaf.
     Sample sample(const Eigen::Vector2d& p) const;
+
+    ///! \brief the center, value and width of the given leaf
+    Sample sample_leaf(const Leaf& leaf) const;
+
+    ///! \brief Lists the runs of identical values along the row of cells containing `y`, from west to east.
+    ///!
+    ///! Walks only the leaves that the row crosses, so a large uniform leaf yields a single run.
+    ///!
+    ///! \param y - the row to scan
+    ///! \param runs - output; cleared first.  Empty if `y` lies outside of the tree.
+    void scan_row(const double y, std::vector<Run>& runs) const;
     
     size_t size() const;
 
@@ -153,16 +318,61 @@ public:
     ///! 
     ///! This is the primary method to populate a useable tree.
     ///!
+    ///! A larger leaf is split down to the cell containing `p` first, unless it already holds `new_value`.
+    ///!
+    ///! Safe to call from several threads at once, and while other versions sharing nodes with this tree are
+    ///! read or dropped.  Splits race through a compare-and-swap on each node's children; a shared block is
+    ///! copied by the one writer that claims it.  The min/max summaries above the cell are refreshed until they
+    ///! agree with their children.  Writers touching disjoint areas only contend on the shared ancestors'
+    ///! summaries.  Readers of this same tree are safe alongside, as long as it shares no nodes with another
+    ///! version (a copied-away block may be freed under them); otherwise, read a copy (e.g. a snapshot).
+    ///! Operations that merge or discard nodes (`fill`, `prune`, `reset`, `store_batch`, `store_block`, ...)
+    ///! are not synchronized, and need exclusive access to the tree.
+    ///!
     ///! \param p - the x,y coordinates to write to
     ///! \param new_value - the value to write at point 'p'
     ///! \return success - fails if out-of-bounds.
     bool store(const Eigen::Vector2d& p, const cell_value_t new_value);
 
+    ///! \brief stores many values at once: `values[n]` into the cell containing `points[n]`.  Points outside the tree are skipped.
+    ///!
+    ///! The points are radix-sorted by the Morton code of their cells, then written in a single depth-first pass,
+    ///! so consecutive points share the descent down to their common ancestor.  Leaves are split down to the
+    ///! written cells, and equal siblings merged back, on the way.  If several points share a cell, the last one wins.
+    ///! Throws `std::invalid_argument` unless there is one value per point.
+    void store_batch(const std::vector<Eigen::Vector2d>& points, const std::vector<cell_value_t>& values);
+
+    ///! \brief writes a rectangular block of cells at once, from a north-up image
+    ///!
+    ///! The tree is built bottom-up beneath the block: nodes are split only as the block requires,
+    ///! and any four equal sibling leaves are merged again before returning.
+    ///!
+    ///! \param i0, j0 - cell index of the block's south-west corner
+    ///! \param width, height - size of the block, in cells.  Must lie inside the layout.
+    ///! \param source - the block's values; row 0 is the block's northernmost row
+    ///! \param stride - distance, in bytes, between the starts of successive rows of `source`
+    void store_block(const size_t i0, const size_t j0, const size_t width, const size_t height,
+                     const cell_value_t* source, const size_t stride);
+
+    ///! \brief sets a rectangular block of cells to a single value
+    ///!
+    ///! Nodes lying wholly inside the block become single leaves, without visiting anything beneath them;
+    ///! only nodes along the block's edges are split, and equal siblings are merged again before returning.
+    ///!
+    ///! \param i0, j0 - cell index of the block's south-west corner
+    ///! \param width, height - size of the block, in cells.  Must lie inside the layout.
+    ///! \param value - the value to write
+    void fill_block(const size_t i0, const size_t j0, const size_t width, const size_t height, const cell_value_t value);
+
     ///! \brief generates a json structure, describing the tree itself
     nlohmann::json to_json_tree() const;
 
     bool write_png(const std::string filename) const;
 
+private:
+    ///! \brief the four samples `interp` blends at `at`, which must lie inside the tree
+    BilinearCorners corners_around(const Eigen::Vector2d& at) const;
+
 private:
     ///! the data layout this tree represents
     geometry::Layout layout;
@@ -10,7 +10,11 @@
 // This StackOverflow answer: 
 //   https://stackoverflow.com/questions/318064/how-do-you-declare-an-interface-in-c/17299151#17299151
 
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -21,6 +25,7 @@
 #include "geometry/cell_value.hpp"
 #include "geometry/layout.hpp"
 #include "geometry/polygon.hpp"
+#include "geometry/sample.hpp"
 
 
 namespace terrain {
@@ -88,11 +93,49 @@ public:
 
     void print() const;
 
+    ///! \brief paints every cell into a north-up image buffer of `dimension` rows, `stride` bytes apart
+    void rasterize_into(geometry::cell_value_t* buffer, const size_t stride) const;
+
     void inline reset();
     void inline reset(const geometry::Layout& _layout);
+    void inline reset(const geometry::Layout& _layout, const geometry::cell_value_t fill_value);
+
+    ///! \brief lists the runs of identical values along the row containing `y`, from west to east
+    void scan_row(const double y, std::vector<geometry::Run>& runs) const;
+
+    ///! \brief stores many values at once: `values[n]` at `points[n]`.  Throws `std::invalid_argument` unless the sizes match.
+    void store_batch(const std::vector<Eigen::Vector2d>& points, const std::vector<geometry::cell_value_t>& values);
+
+    ///! \brief the most recently published version of this terrain; or null, if none has been published yet
+    ///!
+    ///! Safe to call from any number of reader threads, concurrently with `publish`, and lock-free: a reader
+    ///! only retries if a new version was published while it looked.  The version returned never changes, and
+    ///! stays alive for as long as the caller holds on to it: each version is freed once its last reader lets go.
+    std::shared_ptr<const T> snapshot() const;
+
+    ///! \brief publishes a copy of `impl`, as it stands, as the new snapshot
+    ///!
+    ///! The writer keeps updating `impl` freely in between; readers only ever see whole, published versions.
+    ///! Publishers are serialized by a mutex, and each one waits out readers still copying the previous version.
+    void publish();
+
+    ///! \brief publishes an already-built version as the new snapshot
+    ///!
+    ///! `next` is shared with readers as is; so bring any lazily-refreshed index up to date first (a copy does).
+    void publish(std::shared_ptr<const T> next);
 
     std::string summary() const;
 
+private:
+    // The published version lives in `versions[current]`; the other slot is empty between publishes.
+    // A reader counts itself into a slot, and then re-checks `current` before copying out of it; a publisher
+    // fills the idle slot, flips `current`, and waits for the old slot's readers to leave before emptying it.
+    // (`std::atomic_load` on a `shared_ptr` would take a lock from a global pool, on every read.)
+    std::shared_ptr<const T> versions[2];
+    mutable std::atomic<size_t> readers[2] = {};
+    std::atomic<size_t> current = {0};
+    std::mutex publish_mutex;
+
 }; // class Terrain<T>
 
 }; // namespace terrain
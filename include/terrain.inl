@@ -4,11 +4,15 @@
 // NOTE: This is the template-class implementation -- 
 //       It is not compiled until referenced, even though it contains the function implementations.
 
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 using std::cerr;
@@ -33,6 +37,7 @@ using Eigen::Vector2d;
 
 using terrain::geometry::Layout;
 using terrain::geometry::Polygon;
+using terrain::geometry::Run;
 using terrain::Terrain;
 
 // used for reading and write json documents:
@@ -199,14 +204,12 @@ void Terrain<T>::print() const {
     //     fprintf(stderr, "------");
     // } cerr << '\n';
 
+    std::vector<Run> runs;
     for(double y = (layout.get_y_max() - precision/2); y > layout.get_y_min(); y -= precision ){
-        for(double x = (layout.get_x_min() + precision/2); x < layout.get_x_max(); x += precision){
-            auto value = impl.classify({x,y});
-            if( 0 < value ){
-                cerr << 'X';
-            }else{
-                cerr << ' ';
-            }
+        impl.scan_row(y, runs);
+        for( const auto& run : runs ){
+            const size_t cell_count = std::lround((run.x_end - run.x_begin)/precision);
+            cerr << std::string(cell_count, (0 < run.is) ? 'X' : ' ');
         }
         cerr << endl;
     }
@@ -214,6 +217,37 @@ void Terrain<T>::print() const {
 
 }
 
+template<typename T>
+void Terrain<T>::rasterize_into(cell_value_t* buffer, const size_t stride) const {
+    impl.rasterize_into(buffer, stride);
+}
+
+template<typename T>
+void Terrain<T>::scan_row(const double y, std::vector<Run>& runs) const {
+    impl.scan_row(y, runs);
+}
+
+template<typename T>
+void Terrain<T>::publish(){
+    publish( std::make_shared<const T>(impl));
+}
+
+template<typename T>
+void Terrain<T>::publish(std::shared_ptr<const T> next){
+    std::lock_guard<std::mutex> lock(publish_mutex);
+
+    // no reader can pass its re-check on the idle slot until `current` points at it
+    const size_t previous = current.load();
+    versions[1 - previous] = std::move(next);
+    current.store(1 - previous);
+
+    // readers that counted themselves in before the flip may still be copying the previous version
+    while( 0 < readers[previous].load() ){
+        std::this_thread::yield();
+    }
+    versions[previous].reset();
+}
+
 template<typename T>
 void inline Terrain<T>::reset(){
     impl.reset();
@@ -224,6 +258,32 @@ void inline Terrain<T>::reset(const Layout& _layout){
     impl.reset(_layout);
 }
 
+template<typename T>
+void inline Terrain<T>::reset(const Layout& _layout, const cell_value_t fill_value){
+    impl.reset(_layout, fill_value);
+}
+
+template<typename T>
+void Terrain<T>::store_batch(const std::vector<Vector2d>& points, const std::vector<cell_value_t>& values){
+    impl.store_batch(points, values);
+}
+
+template<typename T>
+std::shared_ptr<const T> Terrain<T>::snapshot() const {
+    while( true ){
+        const size_t slot = current.load();
+        readers[slot].fetch_add(1);
+        if( slot == current.load() ){
+            // the publisher leaves this slot alone until every reader counted into it has left
+            std::shared_ptr<const T> version = versions[slot];
+            readers[slot].fetch_sub(1);
+            return version;
+        }
+        // a new version was published in between; this slot may be refilled at any moment
+        readers[slot].fetch_sub(1);
+    }
+}
+
 template<typename T>
 std::string Terrain<T>::summary() const {
     std::ostringstream buffer;
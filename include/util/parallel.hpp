@@ -0,0 +1,64 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _UTIL_PARALLEL_HPP_
+#define _UTIL_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace terrain::util {
+
+///! \brief number of threads worth running at once; at least 1
+inline size_t hardware_threads(){
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+///! \brief runs `task(begin, end)` over contiguous blocks of the range [0, count), spread across the hardware threads.
+///!
+///! Blocks are handed out from a shared counter, so uneven work (e.g. tiles, or rows of a sparse region) still balances.
+///! The calling thread participates; with a single hardware thread this degrades to one call of `task(0, count)`.
+///!
+///! \param count - total number of work items
+///! \param task - callable as `task(size_t begin, size_t end)`.  Must be safe to call concurrently for disjoint blocks.
+///! \param grain - minimum number of items handed out at once
+template<typename task_t>
+void parallel_for(const size_t count, task_t task, const size_t grain = 1){
+    if( 0 == count ){
+        return;
+    }
+
+    const size_t thread_count = std::min(hardware_threads(), (count + grain - 1) / grain);
+    if( 1 >= thread_count ){
+        task(0, count);
+        return;
+    }
+
+    // hand out several blocks per thread, so that a slow block does not stall the whole pass
+    const size_t block = std::max(grain, count / (thread_count * 4));
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](){
+        for( size_t begin = next.fetch_add(block); begin < count; begin = next.fetch_add(block) ){
+            task(begin, std::min(count, begin + block));
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count - 1);
+    for( size_t thread_index = 1; thread_index < thread_count; ++thread_index ){
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for( auto& each : workers ){
+        each.join();
+    }
+}
+
+} // namespace terrain::util
+
+#endif // #ifndef _UTIL_PARALLEL_HPP_
@@ -0,0 +1,50 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#ifndef _UTIL_RADIX_SORT_HPP_
+#define _UTIL_RADIX_SORT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace terrain::util {
+
+///! \brief stable LSD radix sort of (key, payload) pairs, by key, one byte per pass
+///!
+///! Passes over a byte that every key shares are skipped, so keys that only use a few bits (e.g. the
+///! padded Morton codes of a small layout) cost only a few passes.
+template<typename payload_t>
+void radix_sort(std::vector<std::pair<uint64_t, payload_t>>& items){
+    if( items.size() < 2 ){
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, payload_t>> scratch(items.size());
+    for( size_t shift = 0; shift < 64; shift += 8 ){
+        size_t offsets[256] = {};
+        for( const auto& item : items ){
+            ++offsets[(item.first >> shift) & 0xFF];
+        }
+        if( items.size() == offsets[(items[0].first >> shift) & 0xFF] ){
+            // every key has the same byte here: this pass would not move anything
+            continue;
+        }
+
+        size_t total = 0;
+        for( size_t& offset : offsets ){
+            const size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for( const auto& item : items ){
+            scratch[offsets[(item.first >> shift) & 0xFF]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+} // namespace terrain::util
+
+#endif // #ifndef _UTIL_RADIX_SORT_HPP_
@@ -0,0 +1,172 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "delta/delta.hpp"
+#include "geometry/cell_value.hpp"
+#include "grid/grid.hpp"
+#include "quadtree/node.hpp"
+#include "quadtree/tree.hpp"
+#include "util/parallel.hpp"
+
+using terrain::delta::Change;
+using terrain::delta::Delta;
+using terrain::geometry::cell_value_t;
+using terrain::grid::Grid;
+using terrain::quadtree::Node;
+using terrain::quadtree::Tree;
+
+namespace {
+
+// appends the changes turning `from` into `to`, over the square of `cells` x `cells` cells with its south-west corner at (i, j)
+void diff_node( const Node& from, const Node& to, const uint32_t i, const uint32_t j, const uint32_t cells, Delta& changes){
+    if( &from == &to ){
+        // one subtree, shared by both trees
+        return;
+    }
+
+    if( to.get_minimum() == to.get_maximum() ){
+        const cell_value_t value = to.get_minimum();
+        if( (from.get_minimum() != value) || (from.get_maximum() != value) ){
+            changes.push_back({i, j, cells, cells, value});
+        }
+        return;
+    }
+
+    // `to` has children here.  A leaf of `from` stands in for all four of its own quadrants.
+    const bool whole = from.is_leaf();
+    const uint32_t half = cells / 2;
+    diff_node( whole ? from : *from.get_northeast(), *to.get_northeast(), i + half, j + half, half, changes);
+    diff_node( whole ? from : *from.get_northwest(), *to.get_northwest(), i,        j + half, half, changes);
+    diff_node( whole ? from : *from.get_southwest(), *to.get_southwest(), i,        j,        half, changes);
+    diff_node( whole ? from : *from.get_southeast(), *to.get_southeast(), i + half, j,        half, changes);
+}
+
+// index of the first cell in [begin, end) where the two rows differ; `end` if there is none
+size_t find_difference( const cell_value_t* from, const cell_value_t* to, size_t begin, const size_t end){
+#if defined(__AVX2__)
+    for( ; begin + 32 <= end; begin += 32 ){
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + begin));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + begin));
+        const uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        if( 0xFFFFFFFFu != equal ){
+            return begin + __builtin_ctz(~equal);
+        }
+    }
+#endif
+
+    // 8 cells at a time
+    for( ; begin + 8 <= end; begin += 8 ){
+        uint64_t a;
+        uint64_t b;
+        memcpy(&a, from + begin, 8);
+        memcpy(&b, to + begin, 8);
+        if( a != b ){
+            break;
+        }
+    }
+
+    for( ; begin < end; ++begin ){
+        if( from[begin] != to[begin] ){
+            return begin;
+        }
+    }
+    return end;
+}
+
+// appends the runs of differing cells along one row, as changes one cell high
+void diff_row( const cell_value_t* from, const cell_value_t* to, const size_t dimension, const uint32_t j,
+               std::vector<Change>& runs)
+{
+    size_t i = find_difference(from, to, 0, dimension);
+    while( i < dimension ){
+        const cell_value_t value = to[i];
+        size_t end = i + 1;
+        while( (end < dimension) && (to[end] == value) && (from[end] != value) ){
+            ++end;
+        }
+        runs.push_back({static_cast<uint32_t>(i), j, static_cast<uint32_t>(end - i), 1, value});
+        i = find_difference(from, to, end, dimension);
+    }
+}
+
+} // namespace
+
+namespace terrain::delta {
+
+Delta diff(const Tree& from, const Tree& to){
+    if( from.get_layout() != to.get_layout() ){
+        throw std::invalid_argument("delta::diff: the two terrains have different layouts");
+    }
+
+    Delta changes;
+    const uint32_t dimension = static_cast<uint32_t>(to.get_layout().get_dimension());
+    diff_node( from.get_root(), to.get_root(), 0, 0, dimension, changes);
+    return changes;
+}
+
+Delta diff(const Grid& from, const Grid& to){
+    if( from.get_layout() != to.get_layout() ){
+        throw std::invalid_argument("delta::diff: the two terrains have different layouts");
+    }
+
+    const size_t dimension = to.get_layout().get_dimension();
+    std::vector<std::vector<Change>> rows(dimension);
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        for( size_t j = row_begin; j < row_end; ++j ){
+            const size_t offset = j * dimension;
+            diff_row( from.storage.data() + offset, to.storage.data() + offset, dimension, static_cast<uint32_t>(j), rows[j]);
+        }
+    }, 16);
+
+    // stack each row's runs onto identical runs in the row below; both lists are ordered west-to-east
+    Delta changes;
+    std::vector<size_t> open;
+    std::vector<size_t> next;
+    for( const std::vector<Change>& runs : rows ){
+        next.clear();
+        size_t below = 0;
+        for( const Change& run : runs ){
+            while( (below < open.size()) && (changes[open[below]].i < run.i) ){
+                ++below;
+            }
+
+            if( (below < open.size()) && (changes[open[below]].i == run.i)
+                    && (changes[open[below]].width == run.width) && (changes[open[below]].value == run.value) ){
+                ++changes[open[below]].height;
+                next.push_back(open[below]);
+            }else{
+                next.push_back(changes.size());
+                changes.push_back(run);
+            }
+        }
+        open.swap(next);
+    }
+
+    return changes;
+}
+
+void apply_delta(Tree& target, const Delta& delta){
+    for( const Change& change : delta ){
+        target.fill_block(change.i, change.j, change.width, change.height, change.value);
+    }
+}
+
+void apply_delta(Grid& target, const Delta& delta){
+    std::vector<cell_value_t> row;
+    for( const Change& change : delta ){
+        // every row of the block reads the same source row
+        row.assign(change.width, change.value);
+        target.store_block(change.i, change.j, change.width, change.height, row.data(), 0);
+    }
+}
+
+} // namespace terrain::delta
@@ -1,14 +1,22 @@
 // The MIT License 
 // (c) 2019 Daniel Williams
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <iostream>
 
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
 #include <Eigen/Geometry>
 
 #include "geometry/cell_value.hpp"
+#include "geometry/interpolate.hpp"
 #include "geometry/sample.hpp"
+#include "util/parallel.hpp"
 
 using std::cerr;
 using std::endl;
@@ -50,42 +58,137 @@ cell_value_t interpolate_linear(const Eigen::Vector2d& to, const Sample& s1, con
     return round(interp_value);
 }
 
+// fraction of the way from `low` to `high`, clamped to [0, 1]; or 0, if the span is empty
+static inline double weight( const double at, const double low, const double high){
+    const double span = high - low;
+    if( 0 == span ){
+        return 0;
+    }
+    return std::max(0., std::min(1., (at - low) / span));
+}
+
+// blends the four corner values by the separable weights, and rounds once
+static inline cell_value_t blend( const double tx, const double ty,
+                                  const cell_value_t sw, const cell_value_t se, const cell_value_t nw, const cell_value_t ne)
+{
+    const double south = sw + tx * (se - sw);
+    const double north = nw + tx * (ne - nw);
+    return static_cast<cell_value_t>(south + ty * (north - south) + 0.5);
+}
+
+cell_value_t interpolate_bilinear( const Eigen::Vector2d& at, const BilinearCorners& corners){
+    const double tx = weight(at.x(), corners.x_west, corners.x_east);
+    const double ty = weight(at.y(), corners.y_south, corners.y_north);
+    return blend(tx, ty, corners.sw, corners.se, corners.nw, corners.ne);
+}
+
 cell_value_t interpolate_bilinear(  const Eigen::Vector2d& to, 
                                     const Sample& ne,
                                     const Sample& nw,
                                     const Sample& sw,
                                     const Sample& se)
 {
-    // cerr << "    ==>>  to:    @" << to[0] << ", " << to[1] << endl;
-    // cerr << "        - NE:     " << ne.at[0] << ", " << ne.at[1] << " = " << (int)ne.is << endl;
-    // cerr << "        - NW:     " << nw.at[0] << ", " << nw.at[1] << " = " << (int)nw.is << endl;
-    // cerr << "        - SW:     " << sw.at[0] << ", " << sw.at[1] << " = " << (int)sw.is << endl;
-    // cerr << "        - SE:     " << se.at[0] << ", " << se.at[1] << " = " << (int)se.is << endl;
-
-    // not necessary ?
-    // // test for degenerate cases:
-    // if( &sx == &sd ){
-    //     // top or bottom border
-    //     return interpolate_linear(to, {to[0], xn.at[1]}, xn);
-    // }else if( &sy  == &sd ){
-    //     // left or right border
-    //     return interpolate_linear({yn[0], to[1]}, yn);
-    // }
-
-    // calculate full bilinear interpolation:
-    const Eigen::Vector2d upper_point = {to[0], (nw.at[1] + ne.at[1])/2};
-    const Sample upper_sample = { upper_point,
-                                  interpolate_linear(upper_point, nw, ne)};
-
-
-    const Eigen::Vector2d lower_point = {to[0], (sw.at[1] + se.at[1])/2};
-    const Sample lower_sample = { lower_point,
-                                interpolate_linear(lower_point, sw, se) };
-
-    // cerr << "        ::Upper:    " << upper_point[0] << ", " << upper_point[1] << " = " << (int)upper_sample.is << endl;
-    // cerr << "        ::Lower:    " << lower_point[0] << ", " << lower_point[1] << " = " << (int)lower_sample.is << endl;
-
-    return interpolate_linear(to, upper_sample, lower_sample);
+    BilinearCorners corners;
+    corners.x_west = std::min({ne.at.x(), nw.at.x(), sw.at.x(), se.at.x()});
+    corners.x_east = std::max({ne.at.x(), nw.at.x(), sw.at.x(), se.at.x()});
+    corners.y_south = std::min({ne.at.y(), nw.at.y(), sw.at.y(), se.at.y()});
+    corners.y_north = std::max({ne.at.y(), nw.at.y(), sw.at.y(), se.at.y()});
+
+    // place each sample by its own position.  In a degenerate rectangle, the samples given as western or southern
+    // are placed last, so they win the corners the rectangle collapses onto.
+    for( const Sample* sample : {&ne, &se, &nw, &sw} ){
+        const bool east = (corners.x_west < sample->at.x());
+        const bool north = (corners.y_south < sample->at.y());
+        cell_value_t& corner = east ? (north ? corners.ne : corners.se) : (north ? corners.nw : corners.sw);
+        corner = sample->is;
+    }
+
+    return interpolate_bilinear(to, corners);
+}
+
+void BilinearBatch::resize(const size_t count){
+    for( auto* column : {&x, &y, &x_west, &x_east, &y_south, &y_north} ){
+        column->resize(count);
+    }
+    for( auto* column : {&sw, &se, &nw, &ne} ){
+        column->resize(count);
+    }
+}
+
+void BilinearBatch::set(const size_t index, const Eigen::Vector2d& at, const BilinearCorners& corners){
+    x[index] = at.x();
+    y[index] = at.y();
+    x_west[index] = corners.x_west;
+    x_east[index] = corners.x_east;
+    y_south[index] = corners.y_south;
+    y_north[index] = corners.y_north;
+    sw[index] = corners.sw;
+    se[index] = corners.se;
+    nw[index] = corners.nw;
+    ne[index] = corners.ne;
+}
+
+// interpolates the entries [begin, end), one at a time
+static void interpolate_scalar( const BilinearBatch& batch, const size_t begin, const size_t end, cell_value_t* values){
+    for( size_t index = begin; index < end; ++index ){
+        const double tx = weight(batch.x[index], batch.x_west[index], batch.x_east[index]);
+        const double ty = weight(batch.y[index], batch.y_south[index], batch.y_north[index]);
+        values[index] = blend(tx, ty, batch.sw[index], batch.se[index], batch.nw[index], batch.ne[index]);
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+// widens four consecutive bytes into four doubles
+static inline __m256d load_values( const cell_value_t* source){
+    int32_t packed;
+    memcpy(&packed, source, sizeof(packed));
+    return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+}
+
+// as `weight`, for four lanes at once
+static inline __m256d weights( const __m256d at, const __m256d low, const __m256d high){
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d span = _mm256_sub_pd(high, low);
+    const __m256d fraction = _mm256_div_pd(_mm256_sub_pd(at, low), span);
+    const __m256d clamped = _mm256_max_pd(zero, _mm256_min_pd(_mm256_set1_pd(1.), fraction));
+    return _mm256_blendv_pd(clamped, zero, _mm256_cmp_pd(span, zero, _CMP_EQ_OQ));
+}
+
+// interpolates the entries [begin, end), four at a time; returns the first entry left over
+static size_t interpolate_avx2( const BilinearBatch& batch, const size_t begin, const size_t end, cell_value_t* values){
+    size_t index = begin;
+    for( ; index + 4 <= end; index += 4 ){
+        const __m256d tx = weights( _mm256_loadu_pd(&batch.x[index]),
+                                    _mm256_loadu_pd(&batch.x_west[index]), _mm256_loadu_pd(&batch.x_east[index]));
+        const __m256d ty = weights( _mm256_loadu_pd(&batch.y[index]),
+                                    _mm256_loadu_pd(&batch.y_south[index]), _mm256_loadu_pd(&batch.y_north[index]));
+
+        const __m256d sw = load_values(&batch.sw[index]);
+        const __m256d nw = load_values(&batch.nw[index]);
+        const __m256d south = _mm256_fmadd_pd(tx, _mm256_sub_pd(load_values(&batch.se[index]), sw), sw);
+        const __m256d north = _mm256_fmadd_pd(tx, _mm256_sub_pd(load_values(&batch.ne[index]), nw), nw);
+        const __m256d result = _mm256_fmadd_pd(ty, _mm256_sub_pd(north, south), _mm256_add_pd(south, _mm256_set1_pd(0.5)));
+
+        // narrow back down: double -> int32 -> uint16 -> uint8
+        const __m128i integers = _mm256_cvttpd_epi32(result);
+        const __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(integers, integers), _mm_setzero_si128());
+        const int32_t packed = _mm_cvtsi128_si32(bytes);
+        memcpy(values + index, &packed, sizeof(packed));
+    }
+    return index;
+}
+#endif
+
+void interpolate_bilinear( const BilinearBatch& batch, std::vector<cell_value_t>& values){
+    values.resize(batch.size());
+
+    util::parallel_for( batch.size(), [&](const size_t begin, const size_t end){
+        size_t index = begin;
+#if defined(__AVX2__) && defined(__FMA__)
+        index = interpolate_avx2(batch, begin, end, values.data());
+#endif
+        interpolate_scalar(batch, index, end, values.data());
+    }, 4096);
 }
 
 } // namespace terrain::geometry
@@ -1,6 +1,7 @@
 // The MIT License 
 // (c) 2019 Daniel Williams
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
 
@@ -48,6 +49,34 @@ double Layout::constrain_y( const double y) const {
     return std::max(get_y_min(), std::min(y, get_y_max()));
 }
 
+bool Layout::clip(const Vector2d& from, const Vector2d& to, double& t_enter, double& t_exit) const {
+    // Liang-Barsky: narrow [0,1] by each of the four boundary slabs in turn
+    const Vector2d delta = to - from;
+    const double lower[2] = {get_x_min(), get_y_min()};
+    const double upper[2] = {get_x_max(), get_y_max()};
+
+    t_enter = 0.;
+    t_exit = 1.;
+    for( int axis = 0; axis < 2; ++axis ){
+        if( 0 == delta[axis] ){
+            if( (from[axis] < lower[axis]) || (upper[axis] < from[axis]) ){
+                return false;
+            }
+            continue;
+        }
+
+        double t_lower = (lower[axis] - from[axis]) / delta[axis];
+        double t_upper = (upper[axis] - from[axis]) / delta[axis];
+        if( t_upper < t_lower ){
+            std::swap(t_lower, t_upper);
+        }
+        t_enter = std::max(t_enter, t_lower);
+        t_exit = std::min(t_exit, t_upper);
+    }
+
+    return t_enter <= t_exit;
+}
+
 bool Layout::contains(const Vector2d& at) const {
     // outside x-bounds:
     if( (at[0] < x - half_width) || (at[0] > x + half_width) ){
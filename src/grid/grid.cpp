@@ -6,7 +6,9 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <memory>
 #include <vector>
@@ -26,13 +28,24 @@ using std::unique_ptr;
 #include "geometry/layout.hpp"
 
 #include "grid/grid.hpp"
+#include "util/radix_sort.hpp"
 
 using Eigen::Vector2d;
 
 using terrain::geometry::cell_value_t;
+using terrain::geometry::classify_range;
+using terrain::geometry::index_t;
+using terrain::geometry::log_odds_hit;
+using terrain::geometry::log_odds_miss;
+using terrain::geometry::update_log_odds;
+using terrain::geometry::Occupancy;
 using terrain::geometry::Polygon;
+using terrain::geometry::Run;
 using terrain::geometry::Layout;
+using terrain::geometry::Sample;
 using terrain::grid::Grid;
+using terrain::grid::Pyramid;
+using terrain::grid::SummedAreaTable;
 
 Grid::Grid(): 
     layout(Layout())
@@ -46,14 +59,57 @@ Grid::Grid(const Layout& _layout):
     reset();
 }
 
+Grid::Grid(const Grid& other):
+    layout(other.layout),
+    storage(other.storage),
+    pyramid(other.pyramid ? std::make_unique<Pyramid>(*other.pyramid) : nullptr),
+    summed_area(other.summed_area ? std::make_unique<SummedAreaTable>(*other.summed_area) : nullptr)
+{
+    // a copy is typically shared with readers (e.g. `Terrain::publish`), which must not refresh it themselves
+    if(summed_area){
+        summed_area->update(storage);
+    }
+}
+
+Grid& Grid::operator=(const Grid& other){
+    if( this != &other ){
+        layout = other.layout;
+        storage = other.storage;
+        pyramid = other.pyramid ? std::make_unique<Pyramid>(*other.pyramid) : nullptr;
+        summed_area = other.summed_area ? std::make_unique<SummedAreaTable>(*other.summed_area) : nullptr;
+        if(summed_area){
+            summed_area->update(storage);
+        }
+    }
+    return *this;
+}
+
+void Grid::build_pyramid(){
+    pyramid = std::make_unique<Pyramid>(layout.get_dimension());
+    pyramid->build(storage);
+}
+
+void Grid::build_summed_area(){
+    summed_area = std::make_unique<SummedAreaTable>(layout.get_dimension());
+    summed_area->build(storage);
+}
 
 bool Grid::contains(const Vector2d& p) const {
     return layout.contains(p);
 }
 
+// the cell holding `p`: a point on an edge belongs to the cell east / north of it, as with `Layout::rhash`;
+// but a point on the eastern / northern border belongs to the last column / row, rather than wrapping around.
+static index_t cell_index( const Layout& layout, const Vector2d& p ){
+    const uint32_t last = static_cast<uint32_t>(layout.get_dimension() - 1);
+    const uint32_t i = std::min(last, static_cast<uint32_t>((p.x() - layout.get_x_min()) / layout.get_precision()));
+    const uint32_t j = std::min(last, static_cast<uint32_t>((p.y() - layout.get_y_min()) / layout.get_precision()));
+    return layout.rhash(i, j);
+}
+
 cell_value_t Grid::classify(const Vector2d& p) const {
     if(contains(p)){
-        return storage[layout.rhash(p.x(), p.y())];
+        return storage[cell_index(layout, p)];
     }
 
     return geometry::cell_default_value;
@@ -61,6 +117,77 @@ cell_value_t Grid::classify(const Vector2d& p) const {
 
 void Grid::fill(const cell_value_t value){
     memset(storage.data(), value, size());
+
+    if(pyramid){
+        pyramid->fill(value);
+    }
+    if(summed_area){
+        summed_area->invalidate(0);
+    }
+}
+
+std::optional<Sample> Grid::first_hit(const Vector2d& from, const Vector2d& to,
+                                      const std::function<bool(cell_value_t)>& predicate) const
+{
+    std::optional<Sample> hit;
+    layout.trace(from, to, [&](const uint32_t i, const uint32_t j, const double t){
+        const cell_value_t value = storage[layout.rhash(i, j)];
+        if( predicate(value) ){
+            hit.emplace(Sample{from + t * (to - from), value, layout.get_precision()});
+            return true;
+        }
+        return false;
+    });
+    return hit;
+}
+
+void Grid::integrate_scan(const Vector2d& origin, const std::vector<Vector2d>& endpoints){
+    const size_t dimension = layout.get_dimension();
+    const cell_value_t miss = static_cast<cell_value_t>(-log_odds_miss);
+
+    std::vector<index_t> cells;
+    std::vector<cell_value_t> values;
+    size_t lowest_row = dimension;
+    for( const auto& endpoint : endpoints ){
+        cells.clear();
+        layout.trace(origin, endpoint, [&](const uint32_t i, const uint32_t j, const double){
+            cells.push_back(layout.rhash(i, j));
+            return false;
+        });
+        if( cells.empty() ){
+            continue;
+        }
+
+        // the ray's last cell is a hit, if the ray ends inside the grid; every other cell is a miss
+        const bool hit = layout.contains(endpoint);
+        const size_t miss_count = cells.size() - (hit ? 1 : 0);
+
+        // gather, saturating-subtract, scatter: the middle loop is branch-free, so the compiler can vectorize it
+        values.resize(miss_count);
+        for( size_t index = 0; index < miss_count; ++index ){
+            values[index] = storage[cells[index]];
+        }
+        for( size_t index = 0; index < miss_count; ++index ){
+            values[index] = (miss < values[index]) ? (values[index] - miss) : 0;
+        }
+        for( size_t index = 0; index < miss_count; ++index ){
+            storage[cells[index]] = values[index];
+        }
+        if( hit ){
+            storage[cells.back()] = update_log_odds(storage[cells.back()], log_odds_hit);
+        }
+
+        for( const index_t cell : cells ){
+            if(pyramid){
+                pyramid->update(storage, cell % dimension, cell / dimension);
+            }
+            lowest_row = std::min<size_t>(lowest_row, cell / dimension);
+        }
+    }
+
+    if( summed_area && (lowest_row < dimension) ){
+        summed_area->invalidate(lowest_row);
+    }
 }
 
 cell_value_t& Grid::get_cell(const size_t xi, const size_t yi) {
@@ -72,11 +199,135 @@ cell_value_t Grid::get_cell(const size_t xi, const size_t yi) const {
 }
 
 size_t Grid::get_memory_usage() const { 
-    return layout.get_size() * sizeof(cell_value_t);
+    size_t usage = layout.get_size() * sizeof(cell_value_t);
+    if(pyramid){
+        usage += pyramid->get_memory_usage();
+    }
+    if(summed_area){
+        usage += summed_area->get_memory_usage();
+    }
+    return usage;
+}
+
+bool Grid::clip_box(const Vector2d& min, const Vector2d& max,
+                    size_t& i0, size_t& j0, size_t& i1, size_t& j1, bool& overhangs) const
+{
+    const double precision = layout.get_precision();
+    const double dimension = static_cast<double>(layout.get_dimension());
+
+    // index range of the cells overlapping [min, max).  A degenerate box still covers the cell it lies in.
+    const double lo_x = std::floor((min.x() - layout.get_x_min()) / precision);
+    const double lo_y = std::floor((min.y() - layout.get_y_min()) / precision);
+    const double hi_x = std::max(lo_x, std::ceil((max.x() - layout.get_x_min()) / precision) - 1);
+    const double hi_y = std::max(lo_y, std::ceil((max.y() - layout.get_y_min()) / precision) - 1);
+
+    if( (hi_x < 0) || (hi_y < 0) || (dimension <= lo_x) || (dimension <= lo_y) ){
+        // entirely outside the grid
+        overhangs = true;
+        return false;
+    }
+    overhangs = (lo_x < 0) || (lo_y < 0) || (dimension <= hi_x) || (dimension <= hi_y);
+
+    i0 = static_cast<size_t>(std::max(0., lo_x));
+    j0 = static_cast<size_t>(std::max(0., lo_y));
+    i1 = static_cast<size_t>(std::min(dimension - 1, hi_x));
+    j1 = static_cast<size_t>(std::min(dimension - 1, hi_y));
+    return true;
+}
+
+size_t Grid::count_blocked(const Vector2d& min, const Vector2d& max) const {
+    size_t i0, j0, i1, j1;
+    bool overhangs;
+    if( ! clip_box(min, max, i0, j0, i1, j1, overhangs) ){
+        return 0;
+    }
+
+    if(summed_area){
+        return summed_area->count(storage, i0, j0, i1, j1);
+    }
+
+    size_t count = 0;
+    for( size_t j = j0; j <= j1; ++j ){
+        for( size_t i = i0; i <= i1; ++i ){
+            count += geometry::is_blocked(storage[layout.rhash(static_cast<uint32_t>(i), static_cast<uint32_t>(j))]);
+        }
+    }
+    return count;
+}
+
+Occupancy Grid::query_box(const Vector2d& min, const Vector2d& max) const {
+    size_t i0, j0, i1, j1;
+    bool overhangs;
+    if( ! clip_box(min, max, i0, j0, i1, j1, overhangs) ){
+        return classify_range(geometry::cell_default_value, geometry::cell_default_value);
+    }
+
+    cell_value_t minimum = 0xFF;
+    cell_value_t maximum = 0;
+    if( overhangs ){
+        minimum = geometry::cell_default_value;
+        maximum = geometry::cell_default_value;
+    }
+
+    if(pyramid){
+        const auto summary = pyramid->summarize(storage, i0, j0, i1, j1);
+        minimum = std::min(minimum, summary.first);
+        maximum = std::max(maximum, summary.second);
+    }else{
+        for( size_t j = j0; j <= j1; ++j ){
+            for( size_t i = i0; i <= i1; ++i ){
+                const cell_value_t value = storage[layout.rhash(static_cast<uint32_t>(i), static_cast<uint32_t>(j))];
+                minimum = std::min(minimum, value);
+                maximum = std::max(maximum, value);
+            }
+            if( Occupancy::Mixed == classify_range(minimum, maximum) ){
+                break;
+            }
+        }
+    }
+
+    return classify_range(minimum, maximum);
+}
+
+void Grid::scan_row(const double y, std::vector<Run>& runs) const {
+    runs.clear();
+    if( (y < layout.get_y_min()) || (layout.get_y_max() < y) ){
+        return;
+    }
+
+    const size_t dimension = layout.get_dimension();
+    const double precision = layout.get_precision();
+    const double x_min = layout.get_x_min();
+    // the northern border belongs to the last row
+    const size_t j = std::min(dimension - 1, static_cast<size_t>((y - layout.get_y_min()) / precision));
+    const cell_value_t* row = storage.data() + layout.rhash(static_cast<uint32_t>(0), static_cast<uint32_t>(j));
+
+    size_t begin = 0;
+    for( size_t i = 1; i <= dimension; ++i ){
+        if( (dimension == i) || (row[i] != row[begin]) ){
+            runs.push_back({x_min + begin * precision, x_min + i * precision, row[begin]});
+            begin = i;
+        }
+    }
+}
+
+void Grid::rasterize_into(cell_value_t* buffer, const size_t stride) const {
+    const size_t dimension = layout.get_dimension();
+    // storage is south-up; images are north-up
+    for( size_t j = 0; j < dimension; ++j ){
+        memcpy( buffer + (dimension - 1 - j) * stride, storage.data() + j * dimension, dimension);
+    }
 }
 
 void Grid::reset() {
     storage.resize( layout.get_size() );
+
+    if(pyramid){
+        build_pyramid();
+    }
+    if(summed_area){
+        build_summed_area();
+    }
 }
 
 void Grid::reset(const Layout& new_layout){
@@ -85,16 +336,77 @@ void Grid::reset(const Layout& new_layout){
     reset();
 }
 
+void Grid::reset(const Layout& new_layout, const cell_value_t fill_value){
+    reset(new_layout);
+
+    fill(fill_value);
+}
+
 size_t Grid::size() const {
     return storage.size();
 }
 
 bool Grid::store(const Vector2d& p, const cell_value_t new_value) {
     if(contains(p)){
-        storage[layout.rhash(p.x(), p.y())] = new_value;
+        const index_t index = cell_index(layout, p);
+        storage[index] = new_value;
+
+        const size_t dimension = layout.get_dimension();
+        if(pyramid){
+            pyramid->update(storage, index % dimension, index / dimension);
+        }
+        if(summed_area){
+            summed_area->invalidate(index / dimension);
+        }
         return true;
     }
 
     return false;
 }
 
+void Grid::store_batch(const std::vector<Vector2d>& points, const std::vector<cell_value_t>& values){
+    if( points.size() != values.size() ){
+        throw std::invalid_argument("Grid::store_batch: expected one value per point");
+    }
+
+    // sort the writes by storage index, so they sweep through memory once, in order
+    std::vector<std::pair<uint64_t,size_t>> keys;
+    keys.reserve(points.size());
+    for( size_t index = 0; index < points.size(); ++index ){
+        if( contains(points[index]) ){
+            keys.emplace_back(cell_index(layout, points[index]), index);
+        }
+    }
+
+    util::radix_sort(keys);
+
+    const size_t dimension = layout.get_dimension();
+    for( const auto& key : keys ){
+        storage[key.first] = values[key.second];
+        if(pyramid){
+            pyramid->update(storage, key.first % dimension, key.first / dimension);
+        }
+    }
+
+    if(summed_area && (! keys.empty())){
+        summed_area->invalidate(keys.front().first / dimension);
+    }
+}
+
+void Grid::store_block(const size_t i0, const size_t j0, const size_t width, const size_t height,
+                       const cell_value_t* source, const size_t stride)
+{
+    // source rows run north-to-south
+    for( size_t row = 0; row < height; ++row ){
+        memcpy( storage.data() + layout.rhash(static_cast<uint32_t>(i0), static_cast<uint32_t>(j0 + height - 1 - row)),
+                source + row * stride, width);
+    }
+
+    if(pyramid){
+        pyramid->update_region(storage, i0, j0, i0 + width - 1, j0 + height - 1);
+    }
+    if(summed_area){
+        summed_area->invalidate(j0);
+    }
+}
+
@@ -0,0 +1,174 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "geometry/cell_value.hpp"
+#include "grid/grid.hpp"
+#include "grid/operations.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::cell_value_t;
+using terrain::grid::Grid;
+using terrain::grid::Operation;
+
+namespace {
+
+// rows handed to each task at once
+constexpr size_t row_grain = 16;
+
+template<Operation op>
+inline cell_value_t combine_cell(const cell_value_t a, const cell_value_t b){
+    if constexpr (Operation::And == op){
+        return a & b;
+    }else if constexpr (Operation::Or == op){
+        return a | b;
+    }else if constexpr (Operation::Max == op){
+        return std::max(a, b);
+    }else if constexpr (Operation::Min == op){
+        return std::min(a, b);
+    }else{
+        return static_cast<cell_value_t>(std::min(0xFF, a + b));
+    }
+}
+
+#if defined(__AVX2__)
+template<Operation op>
+inline __m256i combine_lanes(const __m256i a, const __m256i b){
+    if constexpr (Operation::And == op){
+        return _mm256_and_si256(a, b);
+    }else if constexpr (Operation::Or == op){
+        return _mm256_or_si256(a, b);
+    }else if constexpr (Operation::Max == op){
+        return _mm256_max_epu8(a, b);
+    }else if constexpr (Operation::Min == op){
+        return _mm256_min_epu8(a, b);
+    }else{
+        return _mm256_adds_epu8(a, b);
+    }
+}
+#endif
+
+template<Operation op>
+void combine_range(cell_value_t* target, const cell_value_t* source, const size_t count){
+    size_t index = 0;
+#if defined(__AVX2__)
+    for( ; index + 32 <= count; index += 32 ){
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(target + index));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + index), combine_lanes<op>(a, b));
+    }
+#endif
+    for( ; index < count; ++index ){
+        target[index] = combine_cell<op>(target[index], source[index]);
+    }
+}
+
+template<Operation op>
+void combine_rows(Grid& target, const Grid& source){
+    const size_t dimension = target.get_layout().get_dimension();
+    cell_value_t* to = target.storage.data();
+    const cell_value_t* from = source.storage.data();
+    terrain::util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        const size_t offset = row_begin * dimension;
+        combine_range<op>(to + offset, from + offset, (row_end - row_begin) * dimension);
+    }, row_grain);
+}
+
+void threshold_range(cell_value_t* cells, const size_t count, const cell_value_t level){
+    size_t index = 0;
+#if defined(__AVX2__)
+    const __m256i levels = _mm256_set1_epi8(static_cast<char>(level));
+    for( ; index + 32 <= count; index += 32 ){
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + index));
+        // value >= level  <=>  max(value, level) == value; the comparison yields 0xFF or 0 per lane
+        const __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(values, levels), values);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cells + index), mask);
+    }
+#endif
+    for( ; index < count; ++index ){
+        cells[index] = (level <= cells[index]) ? 0xFF : 0;
+    }
+}
+
+// brings any summaries of `target` back in line with its storage
+void rebuild_summaries(Grid& target){
+    if( target.has_pyramid() ){
+        target.build_pyramid();
+    }
+    if( target.has_summed_area() ){
+        target.build_summed_area();
+    }
+}
+
+} // namespace
+
+namespace terrain::grid {
+
+void combine(Grid& target, const Grid& source, const Operation op){
+    if( target.get_layout() != source.get_layout() ){
+        throw std::invalid_argument("grid::combine: the two grids have different layouts");
+    }
+
+    switch(op){
+        case Operation::And:          combine_rows<Operation::And>(target, source);          break;
+        case Operation::Or:           combine_rows<Operation::Or>(target, source);           break;
+        case Operation::Max:          combine_rows<Operation::Max>(target, source);          break;
+        case Operation::Min:          combine_rows<Operation::Min>(target, source);          break;
+        case Operation::AddSaturated: combine_rows<Operation::AddSaturated>(target, source); break;
+    }
+
+    rebuild_summaries(target);
+}
+
+void threshold(Grid& target, const cell_value_t level){
+    const size_t dimension = target.get_layout().get_dimension();
+    cell_value_t* cells = target.storage.data();
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        threshold_range(cells + row_begin * dimension, (row_end - row_begin) * dimension, level);
+    }, row_grain);
+
+    rebuild_summaries(target);
+}
+
+std::array<size_t, 256> histogram(const Grid& source){
+    const size_t dimension = source.get_layout().get_dimension();
+    const cell_value_t* cells = source.storage.data();
+
+    std::array<size_t, 256> counts = {};
+    std::mutex merge;
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        // Counting has no useful vector form; instead, four interleaved tables keep runs of equal values
+        // from stalling on the same counter.
+        std::array<std::array<size_t, 256>, 4> partial = {};
+        const size_t begin = row_begin * dimension;
+        const size_t end = row_end * dimension;
+        size_t index = begin;
+        for( ; index + 4 <= end; index += 4 ){
+            ++partial[0][cells[index]];
+            ++partial[1][cells[index + 1]];
+            ++partial[2][cells[index + 2]];
+            ++partial[3][cells[index + 3]];
+        }
+        for( ; index < end; ++index ){
+            ++partial[0][cells[index]];
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        for( size_t value = 0; value < 256; ++value ){
+            counts[value] += partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+        }
+    }, row_grain);
+
+    return counts;
+}
+
+} // namespace terrain::grid
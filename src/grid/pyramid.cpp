@@ -0,0 +1,173 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+#include "grid/pyramid.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::classify_range;
+using terrain::geometry::Occupancy;
+using terrain::grid::Pyramid;
+
+Pyramid::Pyramid(const size_t _dimension):
+    dimension(_dimension)
+{
+    for( size_t level_dimension = dimension >> 1; 0 < level_dimension; level_dimension >>= 1 ){
+        minimums.emplace_back(level_dimension * level_dimension);
+        maximums.emplace_back(level_dimension * level_dimension);
+    }
+}
+
+void Pyramid::build(const std::vector<cell_value_t>& cells){
+    for( size_t level = 1; level <= minimums.size(); ++level ){
+        build_level(cells, level);
+    }
+}
+
+void Pyramid::build_level(const std::vector<cell_value_t>& cells, const size_t level){
+    const size_t level_dimension = dimension >> level;
+    const size_t source_dimension = level_dimension << 1;
+    const cell_value_t* source_min = (1 == level) ? cells.data() : minimums[level-2].data();
+    const cell_value_t* source_max = (1 == level) ? cells.data() : maximums[level-2].data();
+    cell_value_t* dest_min = minimums[level-1].data();
+    cell_value_t* dest_max = maximums[level-1].data();
+
+    util::parallel_for( level_dimension, [&](const size_t row_begin, const size_t row_end){
+        for( size_t j = row_begin; j < row_end; ++j ){
+            const size_t lower = (2*j) * source_dimension;
+            const size_t upper = lower + source_dimension;
+            for( size_t i = 0; i < level_dimension; ++i ){
+                const size_t ll = lower + 2*i;
+                const size_t ul = upper + 2*i;
+                dest_min[i + j*level_dimension] = std::min( std::min(source_min[ll], source_min[ll+1]),
+                                                            std::min(source_min[ul], source_min[ul+1]));
+                dest_max[i + j*level_dimension] = std::max( std::max(source_max[ll], source_max[ll+1]),
+                                                            std::max(source_max[ul], source_max[ul+1]));
+            }
+        }
+    }, 16);
+}
+
+void Pyramid::fill(const cell_value_t value){
+    for( size_t level_index = 0; level_index < minimums.size(); ++level_index ){
+        memset(minimums[level_index].data(), value, minimums[level_index].size());
+        memset(maximums[level_index].data(), value, maximums[level_index].size());
+    }
+}
+
+size_t Pyramid::get_memory_usage() const {
+    size_t usage = 0;
+    for( size_t level_index = 0; level_index < minimums.size(); ++level_index ){
+        usage += minimums[level_index].size() + maximums[level_index].size();
+    }
+    return usage * sizeof(cell_value_t);
+}
+
+std::pair<cell_value_t,cell_value_t> Pyramid::summarize(const std::vector<cell_value_t>& cells,
+                                                        const size_t i0, const size_t j0,
+                                                        const size_t i1, const size_t j1) const
+{
+    cell_value_t minimum = 0xFF;
+    cell_value_t maximum = 0;
+    summarize(cells, minimums.size(), 0, 0, i0, j0, i1, j1, minimum, maximum);
+    return {minimum, maximum};
+}
+
+void Pyramid::summarize(const std::vector<cell_value_t>& cells, const size_t level, const size_t bi, const size_t bj,
+                        const size_t i0, const size_t j0, const size_t i1, const size_t j1,
+                        cell_value_t& minimum, cell_value_t& maximum) const
+{
+    if( Occupancy::Mixed == classify_range(minimum, maximum) ){
+        // no further lookups can change the answer
+        return;
+    }
+
+    // the (inclusive) range of cells covered by this block
+    const size_t lo_i = bi << level;
+    const size_t lo_j = bj << level;
+    const size_t hi_i = ((bi + 1) << level) - 1;
+    const size_t hi_j = ((bj + 1) << level) - 1;
+
+    if( (hi_i < i0) || (i1 < lo_i) || (hi_j < j0) || (j1 < lo_j) ){
+        // disjoint
+        return;
+    }
+
+    if( (i0 <= lo_i) && (hi_i <= i1) && (j0 <= lo_j) && (hi_j <= j1) ){
+        // fully contained: this block's summary answers for every cell beneath it
+        if( 0 == level ){
+            const cell_value_t value = cells[bi + bj*dimension];
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }else{
+            const size_t index = bi + bj*(dimension >> level);
+            minimum = std::min(minimum, minimums[level-1][index]);
+            maximum = std::max(maximum, maximums[level-1][index]);
+        }
+        return;
+    }
+
+    // partial overlap: (only possible above level 0)
+    summarize(cells, level-1, 2*bi,   2*bj,   i0, j0, i1, j1, minimum, maximum);
+    summarize(cells, level-1, 2*bi+1, 2*bj,   i0, j0, i1, j1, minimum, maximum);
+    summarize(cells, level-1, 2*bi,   2*bj+1, i0, j0, i1, j1, minimum, maximum);
+    summarize(cells, level-1, 2*bi+1, 2*bj+1, i0, j0, i1, j1, minimum, maximum);
+}
+
+void Pyramid::update(const std::vector<cell_value_t>& cells, size_t i, size_t j){
+    for( size_t level = 1; level <= minimums.size(); ++level ){
+        i >>= 1;
+        j >>= 1;
+
+        const size_t source_dimension = dimension >> (level-1);
+        const cell_value_t* source_min = (1 == level) ? cells.data() : minimums[level-2].data();
+        const cell_value_t* source_max = (1 == level) ? cells.data() : maximums[level-2].data();
+        const size_t ll = 2*i + (2*j)*source_dimension;
+        const size_t ul = ll + source_dimension;
+
+        const cell_value_t new_min = std::min( std::min(source_min[ll], source_min[ll+1]),
+                                               std::min(source_min[ul], source_min[ul+1]));
+        const cell_value_t new_max = std::max( std::max(source_max[ll], source_max[ll+1]),
+                                               std::max(source_max[ul], source_max[ul+1]));
+
+        const size_t index = i + j*(dimension >> level);
+        if( (new_min == minimums[level-1][index]) && (new_max == maximums[level-1][index]) ){
+            // nothing above this level can change, either
+            return;
+        }
+        minimums[level-1][index] = new_min;
+        maximums[level-1][index] = new_max;
+    }
+}
+
+void Pyramid::update_region(const std::vector<cell_value_t>& cells, size_t i0, size_t j0, size_t i1, size_t j1){
+    for( size_t level = 1; level <= minimums.size(); ++level ){
+        i0 >>= 1;
+        j0 >>= 1;
+        i1 >>= 1;
+        j1 >>= 1;
+
+        const size_t level_dimension = dimension >> level;
+        const size_t source_dimension = level_dimension << 1;
+        const cell_value_t* source_min = (1 == level) ? cells.data() : minimums[level-2].data();
+        const cell_value_t* source_max = (1 == level) ? cells.data() : maximums[level-2].data();
+        cell_value_t* dest_min = minimums[level-1].data();
+        cell_value_t* dest_max = maximums[level-1].data();
+
+        for( size_t j = j0; j <= j1; ++j ){
+            for( size_t i = i0; i <= i1; ++i ){
+                const size_t ll = 2*i + (2*j)*source_dimension;
+                const size_t ul = ll + source_dimension;
+                dest_min[i + j*level_dimension] = std::min( std::min(source_min[ll], source_min[ll+1]),
+                                                            std::min(source_min[ul], source_min[ul+1]));
+                dest_max[i + j*level_dimension] = std::max( std::max(source_max[ll], source_max[ll+1]),
+                                                            std::max(source_max[ul], source_max[ul+1]));
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+#include "grid/summed_area.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::is_blocked;
+using terrain::grid::SummedAreaTable;
+
+SummedAreaTable::SummedAreaTable(const size_t _dimension):
+    dimension(_dimension), stride(_dimension + 1), dirty_row(0), table(stride * stride, 0)
+{}
+
+void SummedAreaTable::build(const std::vector<cell_value_t>& cells){
+    dirty_row = 0;
+    refresh(cells);
+}
+
+void SummedAreaTable::update(const std::vector<cell_value_t>& cells){
+    if( dirty_row < dimension ){
+        refresh(cells);
+    }
+}
+
+size_t SummedAreaTable::count(const std::vector<cell_value_t>& cells,
+                              const size_t i0, const size_t j0, const size_t i1, const size_t j1) const
+{
+    if( dirty_row < dimension ){
+        refresh(cells);
+    }
+
+    const size_t lower = j0 * stride;
+    const size_t upper = (j1 + 1) * stride;
+    return static_cast<size_t>( table[upper + i1 + 1] - table[upper + i0] - table[lower + i1 + 1] + table[lower + i0] );
+}
+
+size_t SummedAreaTable::get_memory_usage() const {
+    return table.size() * sizeof(uint32_t);
+}
+
+void SummedAreaTable::refresh(const std::vector<cell_value_t>& cells) const {
+    const size_t first_row = dirty_row;
+
+    // pass 1: each dirty row becomes the prefix-count of its own cells
+    util::parallel_for( dimension - first_row, [&](const size_t begin, const size_t end){
+        for( size_t j = first_row + begin; j < first_row + end; ++j ){
+            const cell_value_t* source = cells.data() + j * dimension;
+            uint32_t* dest = table.data() + (j + 1) * stride;
+            uint32_t running = 0;
+            for( size_t i = 0; i < dimension; ++i ){
+                running += is_blocked(source[i]);
+                dest[i + 1] = running;
+            }
+        }
+    }, 16);
+
+    // pass 2: accumulate down each column, starting from the last clean table row.
+    // Each task takes a band of columns, and walks it row-by-row, to stay cache-friendly.
+    util::parallel_for( stride, [&](const size_t begin, const size_t end){
+        for( size_t j = first_row + 1; j <= dimension; ++j ){
+            const uint32_t* below = table.data() + (j - 1) * stride;
+            uint32_t* row = table.data() + j * stride;
+            for( size_t i = begin; i < end; ++i ){
+                row[i] += below[i];
+            }
+        }
+    }, 256);
+
+    dirty_row = dimension;
+}
@@ -0,0 +1,157 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "geometry/sample.hpp"
+#include "grid/grid.hpp"
+#include "layers/distance.hpp"
+#include "quadtree/tree.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::is_blocked;
+using terrain::geometry::Layout;
+using terrain::geometry::Run;
+using terrain::grid::Grid;
+using terrain::layers::Layer;
+using terrain::quadtree::Tree;
+
+namespace {
+
+// Column pass: turns per-row distances (in cells) into exact 2D Euclidean distances (in layout units).
+//
+// Each column is the 1D problem: d(q) = min over p of ( (q - p)^2 + f(p) ), where f(p) is the squared row distance
+// at row p.  The rows just past either end of the column are outside the layout, so they are sites with f = 0.
+Layer<float> finish_columns(const Layout& layout, const std::vector<uint32_t>& row_distances){
+    const size_t dimension = layout.get_dimension();
+    const double precision = layout.get_precision();
+    Layer<float> result(layout, 0.f);
+    float* distances = result.data();
+
+    terrain::util::parallel_for( dimension, [&](const size_t column_begin, const size_t column_end){
+        const int64_t n = static_cast<int64_t>(dimension);
+        std::vector<double> f(dimension + 2);
+        std::vector<int64_t> sites(dimension + 2);
+        std::vector<double> bounds(dimension + 3);
+
+        for( size_t column = column_begin; column < column_end; ++column ){
+            // f is indexed by (row + 1), so that the virtual sites at rows -1 and n fit in
+            f[0] = 0;
+            f[dimension + 1] = 0;
+            for( size_t row = 0; row < dimension; ++row ){
+                const double d = row_distances[column + row * dimension];
+                f[row + 1] = d * d;
+            }
+
+            // build the lower envelope of the parabolas rooted at each site
+            size_t k = 0;
+            sites[0] = -1;
+            bounds[0] = -std::numeric_limits<double>::infinity();
+            bounds[1] = std::numeric_limits<double>::infinity();
+            for( int64_t q = 0; q <= n; ++q ){
+                const double fq = f[q + 1];
+                double s;
+                while( true ){
+                    const int64_t p = sites[k];
+                    s = ((fq + q*q) - (f[p + 1] + p*p)) / (2.0 * (q - p));
+                    if( (0 == k) || (bounds[k] < s) ){
+                        break;
+                    }
+                    --k;
+                }
+                if( s <= bounds[k] ){
+                    // only possible at k == 0: this site hides the first one entirely
+                    sites[k] = q;
+                }else{
+                    ++k;
+                    sites[k] = q;
+                    bounds[k] = s;
+                }
+                bounds[k + 1] = std::numeric_limits<double>::infinity();
+            }
+
+            // read the envelope back at each row
+            k = 0;
+            for( int64_t q = 0; q < n; ++q ){
+                while( bounds[k + 1] < q ){
+                    ++k;
+                }
+                const int64_t p = sites[k];
+                const double squared = (q - p) * (q - p) + f[p + 1];
+                distances[column + q * dimension] = static_cast<float>(std::sqrt(squared) * precision);
+            }
+        }
+    }, 16);
+
+    return result;
+}
+
+} // namespace
+
+Layer<float> terrain::layers::distance_transform(const Grid& terrain){
+    const Layout& layout = terrain.get_layout();
+    const size_t dimension = layout.get_dimension();
+    std::vector<uint32_t> row_distances(layout.get_size());
+
+    // row pass: distance (in cells) to the nearest blocked cell in the same row; the borders count as blocked
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        for( size_t row = row_begin; row < row_end; ++row ){
+            uint32_t* distances = row_distances.data() + row * dimension;
+
+            int64_t previous = -1;
+            for( size_t column = 0; column < dimension; ++column ){
+                if( is_blocked(terrain.get_cell(column, row)) ){
+                    previous = column;
+                }
+                distances[column] = static_cast<uint32_t>(column - previous);
+            }
+            int64_t next = dimension;
+            for( int64_t column = dimension - 1; 0 <= column; --column ){
+                if( 0 == distances[column] ){
+                    next = column;
+                }
+                distances[column] = std::min<uint32_t>(distances[column], static_cast<uint32_t>(next - column));
+            }
+        }
+    }, 16);
+
+    return finish_columns(layout, row_distances);
+}
+
+Layer<float> terrain::layers::distance_transform(const Tree& terrain){
+    const Layout& layout = terrain.get_layout();
+    const size_t dimension = layout.get_dimension();
+    const double precision = layout.get_precision();
+    const double x_min = layout.get_x_min();
+    const double y_min = layout.get_y_min();
+    std::vector<uint32_t> row_distances(layout.get_size());
+
+    // row pass: each run of equal leaves is read at once, though its cells are still written one by one.  Equal runs
+    // are merged, so a free run is always bounded by blocked cells (or by the border) on both sides.
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        std::vector<Run> runs;
+        for( size_t row = row_begin; row < row_end; ++row ){
+            uint32_t* distances = row_distances.data() + row * dimension;
+            terrain.scan_row( y_min + (row + 0.5) * precision, runs);
+
+            for( const Run& run : runs ){
+                const int64_t begin = std::lround((run.x_begin - x_min) / precision);
+                const int64_t end = std::lround((run.x_end - x_min) / precision);
+                if( is_blocked(run.is) ){
+                    std::fill(distances + begin, distances + end, 0);
+                    continue;
+                }
+                for( int64_t column = begin; column < end; ++column ){
+                    distances[column] = static_cast<uint32_t>(std::min(column - (begin - 1), end - column));
+                }
+            }
+        }
+    }, 16);
+
+    return finish_columns(layout, row_distances);
+}
@@ -0,0 +1,81 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "geometry/layout.hpp"
+#include "layers/distance.hpp"
+#include "layers/inflation.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::Layout;
+using terrain::layers::cost_inscribed;
+using terrain::layers::cost_lethal;
+using terrain::layers::Layer;
+
+Layer<cell_value_t> terrain::layers::inflate(const Layer<float>& distances, const double radius, const double decay){
+    // written negated, so that a NaN is rejected too
+    if( !(decay > 0.) ){
+        throw std::invalid_argument("layers::inflate: decay must be positive");
+    }else if( !(radius >= 0.) ){
+        throw std::invalid_argument("layers::inflate: radius must not be negative");
+    }
+
+    const Layout& layout = distances.get_layout();
+    const size_t dimension = layout.get_dimension();
+    const double precision = layout.get_precision();
+
+    // the cost at `distance` from the nearest blocked cell, from (just) beyond the inscribed radius
+    const auto cost_at = [radius, decay](const double distance){
+        if( distance <= radius ){
+            return cost_inscribed;
+        }
+        return static_cast<cell_value_t>((cost_inscribed - 1) * std::exp(-decay * (distance - radius)));
+    };
+
+    // Beyond `reach` cells, the cost rounds down to 0.  For a small decay, that may lie far beyond the layout.
+    const double reach = (radius + std::log(static_cast<double>(cost_inscribed - 1)) / decay) / precision;
+    const double farthest = 2.0 * dimension * dimension;
+    const double reach_squared = std::min(farthest, std::ceil(reach * reach));
+
+    // Every distance is (precision * sqrt(k)), for some whole number of cells-squared `k`; so a table over `k` is exact.
+    // It grows with reach squared, though; so it stops at `max_table_size`, and cells beyond compute their cost directly.
+    constexpr size_t max_table_size = 1 << 16;
+    const size_t table_size = static_cast<size_t>(std::min(reach_squared, static_cast<double>(max_table_size - 1))) + 1;
+
+    std::vector<cell_value_t> costs(table_size);
+    costs[0] = cost_lethal;
+    for( size_t k = 1; k < table_size; ++k ){
+        costs[k] = cost_at(std::sqrt(static_cast<double>(k)) * precision);
+    }
+
+    Layer<cell_value_t> result(layout, 0);
+    const float* source = distances.data();
+    cell_value_t* dest = result.data();
+    const float scale = static_cast<float>(1.0 / precision);
+
+    util::parallel_for( dimension, [&](const size_t row_begin, const size_t row_end){
+        for( size_t index = row_begin * dimension; index < row_end * dimension; ++index ){
+            const float cells = source[index] * scale;
+            const float k = cells * cells + 0.5f;
+            if( k < table_size ){
+                dest[index] = costs[static_cast<size_t>(k)];
+            }else if( cells <= reach ){
+                dest[index] = cost_at(source[index]);
+            }
+        }
+    }, 16);
+
+    return result;
+}
+
+Layer<cell_value_t> terrain::layers::inflate(const grid::Grid& terrain, const double radius, const double decay){
+    return inflate(distance_transform(terrain), radius, decay);
+}
+
+Layer<cell_value_t> terrain::layers::inflate(const quadtree::Tree& terrain, const double radius, const double decay){
+    return inflate(distance_transform(terrain), radius, decay);
+}
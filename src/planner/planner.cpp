@@ -0,0 +1,248 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "planner/planner.hpp"
+#include "util/parallel.hpp"
+
+using Eigen::Vector2d;
+
+using terrain::geometry::is_blocked;
+using terrain::geometry::Layout;
+using terrain::grid::Grid;
+using terrain::planner::Path;
+using terrain::planner::Workspace;
+using terrain::quadtree::LeafGraph;
+using terrain::quadtree::Tree;
+
+void Workspace::begin(const size_t node_count){
+    if( costs.size() < node_count ){
+        costs.resize(node_count);
+        parents.resize(node_count);
+        stamps.resize(node_count, generation);
+    }
+    open.clear();
+
+    ++generation;
+    if( 0 == generation ){
+        // wrapped around: the oldest stamps could now look current
+        std::fill(stamps.begin(), stamps.end(), 0);
+        generation = 1;
+    }
+}
+
+size_t Workspace::get_memory_usage() const {
+    return costs.capacity() * sizeof(double)
+         + parents.capacity() * sizeof(uint32_t)
+         + stamps.capacity() * sizeof(uint32_t)
+         + open.capacity() * sizeof(Entry);
+}
+
+namespace {
+
+// A* from `start` to `goal`; leaves the search tree in `workspace.parents`.
+//   - `expand(node, visit)` calls `visit(next, step_cost)` for each node reachable from `node`
+//   - `estimate(node)` is an admissible estimate of the cost remaining from `node` to `goal`
+// \return whether `goal` was reached
+template<typename expand_t, typename estimate_t>
+bool search( Workspace& workspace, const size_t node_count, const uint32_t start, const uint32_t goal,
+             expand_t expand, estimate_t estimate)
+{
+    workspace.begin(node_count);
+    auto& open = workspace.open;
+
+    workspace.costs[start] = 0;
+    workspace.parents[start] = start;
+    workspace.stamps[start] = workspace.generation;
+    open.push_back({estimate(start), 0, start});
+
+    while( ! open.empty() ){
+        std::pop_heap(open.begin(), open.end());
+        const Workspace::Entry current = open.back();
+        open.pop_back();
+
+        if( workspace.costs[current.node] < current.cost ){
+            // stale: this node was reached more cheaply since this entry was queued
+            continue;
+        }else if( goal == current.node ){
+            return true;
+        }
+
+        expand( current.node, [&](const uint32_t next, const double step){
+            const double cost = current.cost + step;
+            if( workspace.reached(next) && (workspace.costs[next] <= cost) ){
+                return;
+            }
+            workspace.costs[next] = cost;
+            workspace.parents[next] = current.node;
+            workspace.stamps[next] = workspace.generation;
+            open.push_back({cost + estimate(next), cost, next});
+            std::push_heap(open.begin(), open.end());
+        });
+    }
+
+    return false;
+}
+
+// walks the parents back from `goal`.  The ends of the path are the exact start and goal points; next in from
+// them come the centers of their own cells (or leaves), so that no step leaves a cell except across a shared border.
+// (A segment inside one square stays inside it; and a step between the centers of two adjacent squares crosses the
+// border they share.)
+template<typename center_t>
+Path trace_back( const Workspace& workspace, const uint32_t start, const uint32_t goal,
+                 const Vector2d& from, const Vector2d& to, center_t center)
+{
+    Path path;
+    auto append = [&path](const Vector2d& waypoint){
+        if( path.waypoints.empty() || (path.waypoints.back() != waypoint) ){
+            path.waypoints.push_back(waypoint);
+        }
+    };
+
+    append(to);
+    if( start != goal ){
+        for( uint32_t node = goal; node != start; node = workspace.parents[node] ){
+            append(center(node));
+        }
+        append(center(start));
+    }
+    append(from);
+    std::reverse(path.waypoints.begin(), path.waypoints.end());
+
+    path.length = 0;
+    for( size_t index = 1; index < path.waypoints.size(); ++index ){
+        path.length += (path.waypoints[index] - path.waypoints[index-1]).norm();
+    }
+    return path;
+}
+
+// the cell containing `p`; the northern / eastern borders belong to the last row / column
+bool locate_cell( const Layout& layout, const Vector2d& p, uint32_t& i, uint32_t& j){
+    if( ! layout.contains(p) ){
+        return false;
+    }
+    const double last = static_cast<double>(layout.get_dimension() - 1);
+    i = static_cast<uint32_t>(std::min(last, std::floor((p.x() - layout.get_x_min()) / layout.get_precision())));
+    j = static_cast<uint32_t>(std::min(last, std::floor((p.y() - layout.get_y_min()) / layout.get_precision())));
+    return true;
+}
+
+} // namespace
+
+Path terrain::planner::plan(const Grid& grid, const Vector2d& start, const Vector2d& goal, Workspace& workspace){
+    const Layout& layout = grid.get_layout();
+    const uint32_t dimension = static_cast<uint32_t>(layout.get_dimension());
+    const double precision = layout.get_precision();
+
+    uint32_t start_i, start_j, goal_i, goal_j;
+    if( (! locate_cell(layout, start, start_i, start_j)) || (! locate_cell(layout, goal, goal_i, goal_j))
+            || is_blocked(grid.get_cell(start_i, start_j)) || is_blocked(grid.get_cell(goal_i, goal_j)) ){
+        return {};
+    }
+
+    const uint32_t start_node = start_i + start_j * dimension;
+    const uint32_t goal_node = goal_i + goal_j * dimension;
+
+    auto free = [&](const uint32_t i, const uint32_t j){
+        return (i < dimension) && (j < dimension) && (! is_blocked(grid.get_cell(i, j)));
+    };
+
+    auto expand = [&](const uint32_t node, auto visit){
+        const uint32_t i = node % dimension;
+        const uint32_t j = node / dimension;
+        // (unsigned wrap-around makes the -1 steps fail the bounds check, too)
+        const bool east = free(i + 1, j);
+        const bool west = free(i - 1, j);
+        const bool north = free(i, j + 1);
+        const bool south = free(i, j - 1);
+        if( east ){ visit(node + 1, precision); }
+        if( west ){ visit(node - 1, precision); }
+        if( north ){ visit(node + dimension, precision); }
+        if( south ){ visit(node - dimension, precision); }
+
+        const double diagonal = M_SQRT2 * precision;
+        if( east && north && free(i + 1, j + 1) ){ visit(node + 1 + dimension, diagonal); }
+        if( west && north && free(i - 1, j + 1) ){ visit(node - 1 + dimension, diagonal); }
+        if( east && south && free(i + 1, j - 1) ){ visit(node + 1 - dimension, diagonal); }
+        if( west && south && free(i - 1, j - 1) ){ visit(node - 1 - dimension, diagonal); }
+    };
+
+    auto estimate = [&](const uint32_t node){
+        const double dx = std::abs(static_cast<double>(node % dimension) - goal_i);
+        const double dy = std::abs(static_cast<double>(node / dimension) - goal_j);
+        // octile distance
+        return precision * (std::max(dx, dy) + (M_SQRT2 - 1) * std::min(dx, dy));
+    };
+
+    if( ! search(workspace, layout.get_size(), start_node, goal_node, expand, estimate) ){
+        return {};
+    }
+
+    const double x_min = layout.get_x_min();
+    const double y_min = layout.get_y_min();
+    return trace_back( workspace, start_node, goal_node, start, goal, [&](const uint32_t node){
+        return Vector2d( x_min + (node % dimension + 0.5) * precision, y_min + (node / dimension + 0.5) * precision);
+    });
+}
+
+Path terrain::planner::plan(const Tree& tree, const LeafGraph& graph,
+                            const Vector2d& start, const Vector2d& goal, Workspace& workspace)
+{
+    if( (! tree.contains(start)) || (! tree.contains(goal)) ){
+        return {};
+    }
+
+    const size_t start_node = graph.find(tree.locate(start));
+    const size_t goal_node = graph.find(tree.locate(goal));
+    if( (LeafGraph::npos == start_node) || (LeafGraph::npos == goal_node) ){
+        return {};
+    }
+
+    auto expand = [&](const uint32_t node, auto visit){
+        const Vector2d& from = graph.centers[node];
+        for( uint32_t edge = graph.offsets[node]; edge < graph.offsets[node + 1]; ++edge ){
+            const uint32_t next = graph.targets[edge];
+            visit(next, (graph.centers[next] - from).norm());
+        }
+    };
+
+    const Vector2d& target = graph.centers[goal_node];
+    auto estimate = [&](const uint32_t node){
+        return (target - graph.centers[node]).norm();
+    };
+
+    if( ! search(workspace, graph.size(), start_node, goal_node, expand, estimate) ){
+        return {};
+    }
+
+    return trace_back( workspace, start_node, goal_node, start, goal, [&](const uint32_t node){
+        return graph.centers[node];
+    });
+}
+
+std::vector<Path> terrain::planner::plan(const Grid& grid, const Vector2d& start, const std::vector<Vector2d>& goals){
+    std::vector<Path> paths(goals.size());
+    util::parallel_for( goals.size(), [&](const size_t begin, const size_t end){
+        Workspace workspace;
+        for( size_t index = begin; index < end; ++index ){
+            paths[index] = plan(grid, start, goals[index], workspace);
+        }
+    });
+    return paths;
+}
+
+std::vector<Path> terrain::planner::plan(const Tree& tree, const LeafGraph& graph,
+                                         const Vector2d& start, const std::vector<Vector2d>& goals)
+{
+    std::vector<Path> paths(goals.size());
+    util::parallel_for( goals.size(), [&](const size_t begin, const size_t end){
+        Workspace workspace;
+        for( size_t index = begin; index < end; ++index ){
+            paths[index] = plan(tree, graph, start, goals[index], workspace);
+        }
+    });
+    return paths;
+}
@@ -0,0 +1,88 @@
+// The MIT License
+// (c) 2019 Daniel Williams
+
+#include <algorithm>
+#include <vector>
+
+#include "quadtree/leaf_graph.hpp"
+#include "util/parallel.hpp"
+
+using terrain::geometry::is_blocked;
+using terrain::quadtree::Direction;
+using terrain::quadtree::Leaf;
+using terrain::quadtree::LeafGraph;
+using terrain::quadtree::Tree;
+
+LeafGraph::LeafGraph(const Tree& tree){
+    tree.leaves([](const cell_value_t value){ return ! is_blocked(value); }, leaves);
+
+    const size_t count = leaves.size();
+    centers.resize(count);
+    widths.resize(count);
+    offsets.assign(count + 1, 0);
+
+    constexpr Direction directions[] = { Direction::North, Direction::East, Direction::South, Direction::West };
+
+    // first pass: place every node, and count its edges
+    util::parallel_for( count, [&](const size_t begin, const size_t end){
+        std::vector<Leaf> found;
+        for( size_t index = begin; index < end; ++index ){
+            const Sample s = tree.sample_leaf(leaves[index]);
+            centers[index] = s.at;
+            widths[index] = s.width;
+
+            uint32_t edges = 0;
+            for( const Direction direction : directions ){
+                tree.neighbors(leaves[index], direction, found);
+                for( const Leaf& neighbor : found ){
+                    edges += (npos != find(neighbor)) ? 1 : 0;
+                }
+            }
+            offsets[index + 1] = edges;
+        }
+    }, 64);
+
+    for( size_t index = 0; index < count; ++index ){
+        offsets[index + 1] += offsets[index];
+    }
+    targets.resize(offsets[count]);
+    border_lengths.resize(offsets[count]);
+
+    // second pass: fill in each node's edges, into its own slice of the arrays
+    util::parallel_for( count, [&](const size_t begin, const size_t end){
+        std::vector<Leaf> found;
+        for( size_t index = begin; index < end; ++index ){
+            size_t edge = offsets[index];
+            for( const Direction direction : directions ){
+                tree.neighbors(leaves[index], direction, found);
+                for( const Leaf& neighbor : found ){
+                    const size_t target = find(neighbor);
+                    if( npos != target ){
+                        targets[edge] = static_cast<uint32_t>(target);
+                        // in a quadtree, the smaller leaf's side lies entirely along the larger's
+                        border_lengths[edge] = std::min(widths[index], widths[target]);
+                        ++edge;
+                    }
+                }
+            }
+        }
+    }, 64);
+}
+
+size_t LeafGraph::find(const Leaf& leaf) const {
+    const auto at = std::lower_bound( leaves.begin(), leaves.end(), leaf.code,
+                                      [](const Leaf& each, const uint64_t code){ return each.code < code; });
+    if( (leaves.end() == at) || ! (*at == leaf) ){
+        return npos;
+    }
+    return static_cast<size_t>(at - leaves.begin());
+}
+
+size_t LeafGraph::get_memory_usage() const {
+    return leaves.size() * sizeof(Leaf)
+         + centers.size() * sizeof(Eigen::Vector2d)
+         + widths.size() * sizeof(double)
+         + offsets.size() * sizeof(uint32_t)
+         + targets.size() * sizeof(uint32_t)
+         + border_lengths.size() * sizeof(double);
+}
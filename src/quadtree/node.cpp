@@ -1,10 +1,15 @@
 // The MIT License 
 // (c) 2019 Daniel Williams
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <Eigen/Geometry>
 using Eigen::Vector2d;
@@ -28,10 +33,131 @@ using terrain::quadtree::Node;
 
 Node::Node(): Node(0) {}
 
+// indices into a child block; see `Node::children`
+enum ChildIndex { NE_INDEX = 0, NW_INDEX = 1, SW_INDEX = 2, SE_INDEX = 3 };
+
+struct Node::Block {
+    // four new leaves, all holding `value`
+    explicit Block(const cell_value_t value):
+        references(1), nodes{ value, value, value, value }
+    {}
+
+    // copies the four nodes, which share their own children with `other`'s
+    Block(const Block& other):
+        references(1), nodes{ other.nodes[NE_INDEX], other.nodes[NW_INDEX], other.nodes[SW_INDEX], other.nodes[SE_INDEX] }
+    {}
+
+    // number of nodes whose `children` point here
+    std::atomic<uint32_t> references;
+    Node nodes[4];
+};
+
+void Node::release(Block* block){
+    if( (nullptr != block) && (1 == block->references.fetch_sub(1, std::memory_order_acq_rel)) ){
+        delete block;
+    }
+}
+
+struct Node::Interner {
+    // identifies a block by its four siblings: each is either a leaf value, or an (already interned) child block
+    struct Key {
+        const Block* children[4];
+        cell_value_t values[4];
+
+        bool operator==(const Key& other) const {
+            return std::equal(children, children + 4, other.children) && std::equal(values, values + 4, other.values);
+        }
+    };
+
+    struct Hash {
+        size_t operator()(const Key& key) const {
+            size_t hash = 0;
+            for( size_t index = 0; index < 4; ++index ){
+                hash = (hash * 31) ^ std::hash<const Block*>()(key.children[index]);
+                hash = (hash * 31) ^ key.values[index];
+            }
+            return hash;
+        }
+    };
+
+    // the first block seen with each key
+    std::unordered_map<Key, Block*, Hash> blocks;
+
+    // every block in `blocks`; reaching one again means its whole subtree is already done
+    std::unordered_set<const Block*> interned;
+};
+
 Node::Node(const cell_value_t _value):
-    northeast(nullptr), northwest(nullptr), southwest(nullptr), southeast(nullptr), value(_value)
+    children(0), value(_value), minimum(_value), maximum(_value)
 {}
 
+Node::Node(const Node& other):
+    children(0), value(other.get_value()), minimum(other.get_minimum()), maximum(other.get_maximum())
+{
+    // from here on, the block is shared: neither side may write through it without copying it first
+    Block* block = block_of( other.children.fetch_and(~owned_tag, std::memory_order_acq_rel) );
+    if( nullptr != block ){
+        block->references.fetch_add(1, std::memory_order_relaxed);
+        children.store(reinterpret_cast<uintptr_t>(block), std::memory_order_release);
+    }
+}
+
+Node& Node::operator=(const Node& other){
+    if( this == &other ){
+        return *this;
+    }
+
+    Block* block = block_of( other.children.fetch_and(~owned_tag, std::memory_order_acq_rel) );
+    if( nullptr != block ){
+        block->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    release( block_of(children.exchange(reinterpret_cast<uintptr_t>(block), std::memory_order_acq_rel)) );
+
+    value.store(other.get_value(), std::memory_order_relaxed);
+    minimum.store(other.get_minimum(), std::memory_order_relaxed);
+    maximum.store(other.get_maximum(), std::memory_order_relaxed);
+    return *this;
+}
+
+void Node::compact(){
+    Interner interner;
+    compact(*this, interner);
+}
+
+void Node::compact(Node& node, Interner& interner){
+    Block* block = block_of(node.children.load(std::memory_order_relaxed));
+    if( nullptr == block ){
+        return;
+    }
+
+    // any block may end up shared below, so nothing stays marked as owned
+    node.children.store(reinterpret_cast<uintptr_t>(block), std::memory_order_relaxed);
+    if( 0 < interner.interned.count(block) ){
+        return;
+    }
+
+    // bottom-up: the children's own blocks are interned first, so equal subtrees now hold equal pointers
+    Interner::Key key;
+    for( size_t index = 0; index < 4; ++index ){
+        Node& child = block->nodes[index];
+        compact(child, interner);
+        key.children[index] = block_of(child.children.load(std::memory_order_relaxed));
+        // an inner node's own value is stale, and does not take part
+        key.values[index] = (nullptr == key.children[index]) ? child.get_value() : 0;
+    }
+
+    const auto inserted = interner.blocks.emplace(key, block);
+    if( inserted.second ){
+        interner.interned.insert(block);
+        return;
+    }
+
+    Block* shared = inserted.first->second;
+    shared->references.fetch_add(1, std::memory_order_relaxed);
+    node.children.store(reinterpret_cast<uintptr_t>(shared), std::memory_order_release);
+    release(block);
+}
+
 void Node::draw(std::ostream& sink, const string& prefix, const string& as, const bool show_pointers) const {
 
     sink << prefix << "[" << as << "]: ";
@@ -46,22 +172,17 @@ void Node::draw(std::ostream& sink, const string& prefix, const string& as, cons
     
     if(!is_leaf()){
         auto next_prefix = prefix + "    ";
-        northeast->draw(sink, next_prefix, "NE", show_pointers);
-        northwest->draw(sink, next_prefix, "NW", show_pointers);
-        southwest->draw(sink, next_prefix, "SW", show_pointers);
-        southeast->draw(sink, next_prefix, "SE", show_pointers);
+        get_northeast()->draw(sink, next_prefix, "NE", show_pointers);
+        get_northwest()->draw(sink, next_prefix, "NW", show_pointers);
+        get_southwest()->draw(sink, next_prefix, "SW", show_pointers);
+        get_southeast()->draw(sink, next_prefix, "SE", show_pointers);
     }
 }
 
 void Node::fill(const cell_value_t fill_value){
-    if(is_leaf()){
-        set_value(fill_value);
-    }else{
-        northeast->fill(fill_value);
-        northwest->fill(fill_value);
-        southeast->fill(fill_value);
-        southwest->fill(fill_value);
-    }
+    // drops (our reference to) any children, rather than writing through blocks shared with other versions
+    reset();
+    set_value(fill_value);
 }
 
 size_t Node::get_count() const {
@@ -69,10 +190,10 @@ size_t Node::get_count() const {
         return 1;
     }else{
         size_t count = 0;
-        count += northeast->get_count();
-        count += northwest->get_count();
-        count += southeast->get_count();
-        count += southwest->get_count();
+        count += get_northeast()->get_count();
+        count += get_northwest()->get_count();
+        count += get_southeast()->get_count();
+        count += get_southwest()->get_count();
         return count + 1;
     }
 }
@@ -81,42 +202,70 @@ size_t Node::get_height() const {
     if(is_leaf()){
         return 1;
     }else{
-        const size_t ne_height = northeast->get_height();
-        const size_t nw_height = northwest->get_height();
-        const size_t se_height = southeast->get_height();
-        const size_t sw_height = southwest->get_height();
+        const size_t ne_height = get_northeast()->get_height();
+        const size_t nw_height = get_northwest()->get_height();
+        const size_t se_height = get_southeast()->get_height();
+        const size_t sw_height = get_southwest()->get_height();
         
         const size_t max_height = std::max(ne_height, std::max(nw_height, std::max(se_height, sw_height)));
         return max_height + 1;
     }
 }
 
+size_t Node::get_unique_count() const {
+    std::unordered_set<const Block*> seen;
+    std::vector<const Block*> pending;
+    const Block* own = get_block();
+    if( nullptr != own ){
+        seen.insert(own);
+        pending.push_back(own);
+    }
+
+    while( ! pending.empty() ){
+        const Block* block = pending.back();
+        pending.pop_back();
+        for( const Node& child : block->nodes ){
+            const Block* next = child.get_block();
+            if( (nullptr != next) && seen.insert(next).second ){
+                pending.push_back(next);
+            }
+        }
+    }
+
+    return 1 + 4 * seen.size();
+}
+
+size_t Node::get_memory_usage() const {
+    const size_t blocks = (get_unique_count() - 1) / 4;
+    return sizeof(Node) + blocks * sizeof(Block);
+}
+
 Node* Node::get_northeast() const {
-    return northeast.get();
+    Block* block = get_block();
+    return (nullptr == block) ? nullptr : (block->nodes + NE_INDEX);
 }
 
 Node* Node::get_northwest() const {
-    return northwest.get();
+    Block* block = get_block();
+    return (nullptr == block) ? nullptr : (block->nodes + NW_INDEX);
 }
 
 Node* Node::get_southeast() const {
-    return southeast.get();
+    Block* block = get_block();
+    return (nullptr == block) ? nullptr : (block->nodes + SE_INDEX);
 }
 
 Node* Node::get_southwest() const {
-    return southwest.get();
+    Block* block = get_block();
+    return (nullptr == block) ? nullptr : (block->nodes + SW_INDEX);
 }
     
 bool Node::is_leaf() const{
-    return ! northeast;
-}
-
-cell_value_t& Node::get_value() {
-    return this->value;
+    return 0 == children.load(std::memory_order_acquire);
 }
 
 cell_value_t Node::get_value() const {
-    return this->value;
+    return value.load(std::memory_order_relaxed);
 }
 
 bool Node::load(const nlohmann::json& doc){
@@ -127,6 +276,7 @@ bool Node::load(const nlohmann::json& doc){
         get_northwest()->load(doc["NW"]);
         get_southeast()->load(doc["SE"]);
         get_southwest()->load(doc["SW"]);
+        update_summary();
         return true;
     }else{
         assert(is_leaf());
@@ -139,53 +289,168 @@ bool Node::operator==(const Node& other) const {
     return static_cast<const void*>(this) == static_cast<const void*>(&other);
 }
 
-void Node::prune() {
-    if( is_leaf() ){
-        return;
+namespace {
+
+// a node visited by `prune()`, and the way back to it from the root
+struct PrunePath {
+    PrunePath* parent;
+    // which of the parent's children this is
+    int quadrant;
+    // this node, once it may be written to; i.e. once every block above it belongs to the pruned tree alone
+    Node* writable;
+};
+
+Node* get_child(const Node& node, const int quadrant){
+    switch(quadrant){
+        case NE_INDEX: return node.get_northeast();
+        case NW_INDEX: return node.get_northwest();
+        case SW_INDEX: return node.get_southwest();
+        default:       return node.get_southeast();
+    }
+}
+
+// splits the blocks on the path down to this node, copying any that are shared; only once something beneath changes
+Node& make_writable(PrunePath& path){
+    if( nullptr == path.writable ){
+        Node& parent = make_writable(*path.parent);
+        parent.split();
+        path.writable = get_child(parent, path.quadrant);
     }
+    return *path.writable;
+}
 
-    northeast->prune();
-    northwest->prune();
-    southeast->prune();
-    southwest->prune();
+// collapses every subtree beneath `node` whose leaves all hold one value
+// \return whether `node` is (now) a leaf
+bool prune_node(Node& node, PrunePath& path){
+    if( node.is_leaf() ){
+        return true;
+    }
 
-    bool has_only_leaves = get_northeast()->is_leaf()
-                        && get_northwest()->is_leaf()
-                        && get_southeast()->is_leaf()
-                        && get_southwest()->is_leaf();
-    
-    if( has_only_leaves ){
-        auto nev = get_northeast()->get_value();
-        auto nwv = get_northwest()->get_value();
-        auto sev = get_southeast()->get_value();
-        auto swv = get_southwest()->get_value();
-
-        if( (nev == nwv) && (nwv == sev) && (sev == swv )){
-            reset();
-            set_value(nev);
-        }
+    // reads the leaves themselves, rather than trusting the summaries
+    bool merge = true;
+    for( int quadrant = NE_INDEX; quadrant <= SE_INDEX; ++quadrant ){
+        // a merge beneath went to a copy of `node`, if `node` was shared
+        Node& current = (nullptr == path.writable) ? node : *path.writable;
+        PrunePath below = { &path, quadrant, nullptr };
+        merge = prune_node( *get_child(current, quadrant), below) && merge;
     }
+
+    Node& current = (nullptr == path.writable) ? node : *path.writable;
+    const cell_value_t value = current.get_northeast()->get_value();
+    merge = merge && (value == current.get_northwest()->get_value())
+                  && (value == current.get_southwest()->get_value())
+                  && (value == current.get_southeast()->get_value());
+    if( merge ){
+        Node& target = make_writable(path);
+        target.reset();
+        target.set_value(value);
+        return true;
+    }
+
+    // refreshes the summary in place, even if `current` is shared, without a copy: the summary depends only on
+    // the subtree beneath, which every sharing version also shares; so they all want this same value.  The
+    // fields are relaxed atomics, so a version reading them meanwhile sees either the old or the new value.
+    current.update_summary();
+    return false;
+}
+
+} // namespace
+
+void Node::prune() {
+    PrunePath root = { nullptr, NE_INDEX, this };
+    prune_node(*this, root);
 }
 
 void Node::set_value(cell_value_t new_value){
-    this->value = new_value;
+    value.store(new_value, std::memory_order_relaxed);
+    minimum.store(new_value, std::memory_order_relaxed);
+    maximum.store(new_value, std::memory_order_relaxed);
+}
+
+// reads the min/max over a block of four children
+static std::pair<cell_value_t,cell_value_t> summarize_block(const Node* block){
+    const cell_value_t minimum = std::min( std::min(block[NE_INDEX].get_minimum(), block[NW_INDEX].get_minimum()),
+                                           std::min(block[SW_INDEX].get_minimum(), block[SE_INDEX].get_minimum()));
+    const cell_value_t maximum = std::max( std::max(block[NE_INDEX].get_maximum(), block[NW_INDEX].get_maximum()),
+                                           std::max(block[SW_INDEX].get_maximum(), block[SE_INDEX].get_maximum()));
+    return {minimum, maximum};
+}
+
+bool Node::update_summary(){
+    const Block* block = get_block();
+    if( nullptr == block ){
+        return false;
+    }
+
+    const auto summary = summarize_block(block->nodes);
+    if( (summary.first == get_minimum()) && (summary.second == get_maximum()) ){
+        return false;
+    }
+
+    minimum.store(summary.first, std::memory_order_relaxed);
+    maximum.store(summary.second, std::memory_order_relaxed);
+    return true;
+}
+
+bool Node::update_summary_concurrent(){
+    const Block* block = get_block();
+    if( nullptr == block ){
+        return false;
+    }
+
+    // order this thread's leaf write before its reads of the siblings' summaries
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto summary = summarize_block(block->nodes);
+    bool changed = false;
+    while( (summary.first != get_minimum()) || (summary.second != get_maximum()) ){
+        minimum.store(summary.first, std::memory_order_relaxed);
+        maximum.store(summary.second, std::memory_order_relaxed);
+        changed = true;
+
+        // a racing writer may have published a (now stale) summary of its own in between; check again
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        summary = summarize_block(block->nodes);
+    }
+    return changed;
 }
 
 void Node::reset(){
-    if(northeast != nullptr) this->northeast.release();
-    if(northwest != nullptr) this->northwest.release();
-    if(southeast != nullptr) this->southeast.release();
-    if(southwest != nullptr) this->southwest.release();
+    release( block_of(children.exchange(0, std::memory_order_acq_rel)) );
 }
 
 void Node::split(){
-    if(is_leaf()){
-        value = NAN;
-
-        this->northeast = make_unique<Node>(value);
-        this->northwest = make_unique<Node>(value);
-        this->southeast = make_unique<Node>(value);
-        this->southwest = make_unique<Node>(value);
+    uintptr_t current = children.load(std::memory_order_acquire);
+    while( true ){
+        if( 0 == current ){
+            // the children cover the same area, so they start with the same value
+            Block* fresh = new Block(get_value());
+            if( children.compare_exchange_strong(current, reinterpret_cast<uintptr_t>(fresh) | owned_tag,
+                                                 std::memory_order_acq_rel, std::memory_order_acquire) ){
+                return;
+            }
+            // another thread split this node first; use theirs instead
+            delete fresh;
+        }else if( 0 != (current & owned_tag) ){
+            return;
+        }else if( 0 != (current & copying_tag) ){
+            // another thread is copying the shared block
+            std::this_thread::yield();
+            current = children.load(std::memory_order_acquire);
+        }else if( children.compare_exchange_weak(current, current | copying_tag,
+                                                 std::memory_order_acquire, std::memory_order_acquire) ){
+            // Claimed.  This node still references the block, and only the claimant replaces it, so it stays alive.
+            Block* shared = block_of(current);
+            if( 1 == shared->references.load(std::memory_order_acquire) ){
+                // no other node references it any more (nor can gain a reference, without copying this version)
+                children.store(current | owned_tag, std::memory_order_release);
+                return;
+            }
+
+            Block* copy = new Block(*shared);
+            children.store(reinterpret_cast<uintptr_t>(copy) | owned_tag, std::memory_order_release);
+            release(shared);
+            return;
+        }
     }
 }
 
@@ -194,32 +459,26 @@ void Node::split(const double precision, const double width){
         return;
     }
     
-    if(is_leaf()){
-        split();
-    }
+    split();
 
     const double half_width = width / 2;
 
-    this->northeast->split(precision, half_width);
-    this->northwest->split(precision, half_width);
-    this->southeast->split(precision, half_width);
-    this->southwest->split(precision, half_width);
+    get_northeast()->split(precision, half_width);
+    get_northwest()->split(precision, half_width);
+    get_southeast()->split(precision, half_width);
+    get_southwest()->split(precision, half_width);
 }
 
 nlohmann::json Node::to_json() const {
     nlohmann::json doc;
 
     if(is_leaf()){
-        doc = json({this->value}, false, json::value_t::number_integer)[0];
+        doc = json({get_value()}, false, json::value_t::number_integer)[0];
     }else{
-        assert(northeast);
-        assert(northwest);
-        assert(southeast);
-        assert(southwest);
-        doc["NE"] = northeast->to_json();
-        doc["NW"] = northwest->to_json();
-        doc["SE"] = southeast->to_json();
-        doc["SW"] = southwest->to_json();
+        doc["NE"] = get_northeast()->to_json();
+        doc["NW"] = get_northwest()->to_json();
+        doc["SE"] = get_southeast()->to_json();
+        doc["SW"] = get_southwest()->to_json();
     }
     return doc;
 }
@@ -1,12 +1,17 @@
 // The MIT License 
 // (c) 2019 Daniel Williams
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <memory>
+#include <vector>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <stdexcept>
 
 using std::string;
 using std::cerr;
@@ -18,46 +23,239 @@ using Eigen::Vector2d;
 #include <nlohmann/json/json.hpp>
 using nlohmann::json;
 
+#include "geometry/interpolate.hpp"
 #include "geometry/layout.hpp"
 #include "quadtree/tree.hpp"
+#include "util/parallel.hpp"
+#include "util/radix_sort.hpp"
 
 using namespace terrain;
+using geometry::is_blocked;
 using geometry::Layout;
 using quadtree::Tree;
+using quadtree::Combine;
+using quadtree::Direction;
+using quadtree::Leaf;
 using quadtree::Node;
 
-// main method for descending through a tree and returning the appropriate location / node / value 
+// descends a single level: from `current_node` into whichever child contains `target`
 // note: weakly optimized; intended to be a hot path.
-void descend( const Vector2d& target, double& x_c, double& y_c, const double start_width, Node* & current_node){
-    double current_width = start_width;
-    double next_width = start_width*0.5;
+inline void step( const Vector2d& target, double& x_c, double& y_c, double& next_width, Node* & current_node){
+    next_width *= 0.5;
+
+    if(target[0] > x_c){
+        if( target[1] > y_c){
+            x_c += next_width;
+            y_c += next_width;
+            current_node = current_node->get_northeast();
+        }else{
+            x_c += next_width;
+            y_c -= next_width;
+            current_node = current_node->get_southeast();
+        }
+    }else{
+        if( target[1] > y_c){
+            x_c -= next_width;
+            y_c += next_width;
+            current_node = current_node->get_northwest();
+        }else{
+            x_c -= next_width;
+            y_c -= next_width;
+            current_node = current_node->get_southwest();
+        }
+    }
+}
+
+// as `step`, except that a target lying exactly on a dividing line is resolved towards `direction`
+// (used when walking along a segment, where the target is the point the segment crosses into the next leaf)
+inline void step_towards( const Vector2d& target, const Vector2d& direction, double& x_c, double& y_c, double& next_width, Node* & current_node){
+    next_width *= 0.5;
 
+    const bool east = (target[0] > x_c) || ((target[0] == x_c) && (0 < direction[0]));
+    const bool north = (target[1] > y_c) || ((target[1] == y_c) && (0 < direction[1]));
+
+    x_c += east ? next_width : -next_width;
+    y_c += north ? next_width : -next_width;
+
+    if(east){
+        current_node = north ? current_node->get_northeast() : current_node->get_southeast();
+    }else{
+        current_node = north ? current_node->get_northwest() : current_node->get_southwest();
+    }
+}
+
+// main method for descending through a tree and returning the appropriate location / node / value 
+// note: weakly optimized; intended to be a hot path.
+// 
+// \param half_width - on entry: the half-width of `current_node`.  On exit: the half-width of the leaf found.
+void descend( const Vector2d& target, double& x_c, double& y_c, double& half_width, Node* & current_node){
     while( ! current_node->is_leaf() )
     {
-        current_width = next_width;
-        next_width *= 0.5;
-
-        if(target[0] > x_c){
-            if( target[1] > y_c){
-                x_c += next_width;
-                y_c += next_width;
-                current_node = current_node->get_northeast();
-            }else{
-                x_c += next_width;
-                y_c -= next_width;
-                current_node = current_node->get_southeast();
-            }
+        step( target, x_c, y_c, half_width, current_node);
+    }
+}
+
+// appends the leaves crossed by the horizontal line at `y`, west-to-east, merging neighbors of equal value
+static void scan_node( const Node& node, const double x_c, const double y_c, const double half_width,
+                       const double y, std::vector<Run>& runs)
+{
+    if( node.is_leaf() ){
+        const double x_begin = x_c - half_width;
+        if( (! runs.empty()) && (runs.back().is == node.get_value()) && (runs.back().x_end == x_begin) ){
+            runs.back().x_end = x_c + half_width;
         }else{
-            if( target[1] > y_c){
-                x_c -= next_width;
-                y_c += next_width;
-                current_node = current_node->get_northwest();
-            }else{
-                x_c -= next_width;
-                y_c -= next_width;
-                current_node = current_node->get_southwest();
-            }
+            runs.push_back({x_begin, x_c + half_width, node.get_value()});
+        }
+        return;
+    }
+
+    const double quarter_width = half_width * 0.5;
+    // same tie-break as `descend`: a line exactly on the divide belongs to the southern half
+    if( y > y_c ){
+        scan_node( *node.get_northwest(), x_c - quarter_width, y_c + quarter_width, quarter_width, y, runs);
+        scan_node( *node.get_northeast(), x_c + quarter_width, y_c + quarter_width, quarter_width, y, runs);
+    }else{
+        scan_node( *node.get_southwest(), x_c - quarter_width, y_c - quarter_width, quarter_width, y, runs);
+        scan_node( *node.get_southeast(), x_c + quarter_width, y_c - quarter_width, quarter_width, y, runs);
+    }
+}
+
+// accumulates the min/max summary of every leaf overlapping the box [min, max)
+static void summarize_box( const Node& node, const double x_c, const double y_c, const double width,
+                           const Vector2d& min, const Vector2d& max,
+                           cell_value_t& minimum, cell_value_t& maximum)
+{
+    if( Occupancy::Mixed == classify_range(minimum, maximum) ){
+        // no further lookups can change the answer
+        return;
+    }
+
+    const double half_width = width * 0.5;
+    const double x_lo = x_c - half_width;
+    const double x_hi = x_c + half_width;
+    const double y_lo = y_c - half_width;
+    const double y_hi = y_c + half_width;
+
+    // overlap with the half-open box [min, max) -- or, for a degenerate box, the node containing its corner
+    const bool overlaps_x = (min[0] < x_hi) && ((x_lo < max[0]) || (x_lo <= min[0]));
+    const bool overlaps_y = (min[1] < y_hi) && ((y_lo < max[1]) || (y_lo <= min[1]));
+    if( ! (overlaps_x && overlaps_y) ){
+        return;
+    }
+
+    const bool contained = (min[0] <= x_lo) && (x_hi <= max[0]) && (min[1] <= y_lo) && (y_hi <= max[1]);
+    if( contained || node.is_leaf() ){
+        minimum = std::min(minimum, node.get_minimum());
+        maximum = std::max(maximum, node.get_maximum());
+        return;
+    }
+
+    const double quarter_width = half_width * 0.5;
+    summarize_box( *node.get_northeast(), x_c + quarter_width, y_c + quarter_width, half_width, min, max, minimum, maximum);
+    summarize_box( *node.get_northwest(), x_c - quarter_width, y_c + quarter_width, half_width, min, max, minimum, maximum);
+    summarize_box( *node.get_southwest(), x_c - quarter_width, y_c - quarter_width, half_width, min, max, minimum, maximum);
+    summarize_box( *node.get_southeast(), x_c + quarter_width, y_c - quarter_width, half_width, min, max, minimum, maximum);
+}
+
+// Locational codes (see `Leaf`): the quadrant a leaf lies in at level `l` of its path is held in the two bits at
+// `quadrant_shift(l)` -- the x-bit, then the y-bit above it.  Quadrants are thus numbered SW, SE, NW, NE.
+constexpr uint64_t code_x_bits = 0x5555555555555555ull;
+constexpr uint64_t code_y_bits = ~code_x_bits;
+
+static inline size_t quadrant_shift( const size_t depth ){
+    return Layout::index_bit_size - 2*depth;
+}
+
+static inline Node* child( const Node& node, const uint64_t quadrant ){
+    switch(quadrant){
+        case 0: return node.get_southwest();
+        case 1: return node.get_southeast();
+        case 2: return node.get_northwest();
+        default: return node.get_northeast();
+    }
+}
+
+// moves `code` to the same-size leaf across the given side of a leaf at `depth`; by adding or subtracting one unit
+// along a single axis of the (dilated) Morton code.
+// \return false if that side is the border of the tree
+static bool step_code( uint64_t& code, const size_t depth, const Direction direction ){
+    if( 0 == depth ){
+        return false;
+    }
+
+    const bool vertical = (Direction::North == direction) || (Direction::South == direction);
+    const uint64_t mask = vertical ? code_y_bits : code_x_bits;
+    const uint64_t unit = uint64_t(1) << (quadrant_shift(depth) + (vertical ? 1 : 0));
+    const uint64_t part = code & mask;
+
+    uint64_t moved;
+    if( (Direction::North == direction) || (Direction::East == direction) ){
+        // the carry ripples across the other axis' bits, since they are all set
+        moved = ((part | ~mask) + unit) & mask;
+        if( moved < part ){
+            return false;
+        }
+    }else{
+        if( 0 == part ){
+            return false;
+        }
+        moved = (part - unit) & mask;
+    }
+
+    code = (code & ~mask) | moved;
+    return true;
+}
+
+// appends the leaves beneath `node` that touch its given side; south-to-north, or west-to-east
+static void collect_side( const Node& node, const uint64_t code, const size_t depth, const Direction side,
+                          std::vector<Leaf>& found)
+{
+    if( node.is_leaf() ){
+        found.push_back({code, static_cast<uint8_t>(depth)});
+        return;
+    }
+
+    // the two quadrants along each side; indexed by Direction: North, East, South, West
+    static constexpr uint64_t quadrants[4][2] = { {2, 3}, {1, 3}, {0, 1}, {0, 2} };
+    const size_t shift = quadrant_shift(depth + 1);
+    for( const uint64_t quadrant : quadrants[static_cast<size_t>(side)] ){
+        collect_side( *child(node, quadrant), code | (quadrant << shift), depth + 1, side, found);
+    }
+}
+
+// appends every leaf lying exactly at `target` depth beneath `node`
+static void collect_depth( const Node& node, const uint64_t code, const size_t depth, const size_t target,
+                           std::vector<Leaf>& found)
+{
+    if( node.is_leaf() ){
+        if( depth == target ){
+            found.push_back({code, static_cast<uint8_t>(depth)});
+        }
+        return;
+    }else if( depth == target ){
+        return;
+    }
+
+    const size_t shift = quadrant_shift(depth + 1);
+    for( uint64_t quadrant = 0; quadrant < 4; ++quadrant ){
+        collect_depth( *child(node, quadrant), code | (quadrant << shift), depth + 1, target, found);
+    }
+}
+
+// appends the leaves beneath `node` whose values satisfy `predicate`; in key order
+static void collect_leaves( const Node& node, const uint64_t code, const size_t depth,
+                            const std::function<bool(cell_value_t)>& predicate, std::vector<Leaf>& found)
+{
+    if( node.is_leaf() ){
+        if( predicate(node.get_value()) ){
+            found.push_back({code, static_cast<uint8_t>(depth)});
         }
+        return;
+    }
+
+    const size_t shift = quadrant_shift(depth + 1);
+    for( uint64_t quadrant = 0; quadrant < 4; ++quadrant ){
+        collect_leaves( *child(node, quadrant), code | (quadrant << shift), depth + 1, predicate, found);
     }
 }
 
@@ -69,8 +267,46 @@ Tree::Tree(const Layout& _layout)
     reset();
 }
 
+Tree::Tree(const Tree& other)
+    : layout(other.layout), root(std::make_unique<Node>(*other.root))
+{}
+
+Tree& Tree::operator=(const Tree& other){
+    // copy first: `other` may be this tree
+    std::unique_ptr<Node> next = std::make_unique<Node>(*other.root);
+    layout = other.layout;
+    root = std::move(next);
+    return *this;
+}
+
 Tree::~Tree(){
-    root.release();
+    root.reset();
+}
+
+void Tree::balance(){
+    // Deepest leaves first: each forces its neighbors down to within one level of itself.  Every leaf split off
+    // in doing so is shallower, and so is itself checked on a later pass.
+    std::vector<Leaf> leaves;
+    for( size_t depth = root->get_height() - 1; 2 <= depth; --depth ){
+        leaves.clear();
+        collect_depth( *root, 0, 0, depth, leaves);
+
+        for( const Leaf& leaf : leaves ){
+            for( const Direction direction : {Direction::North, Direction::East, Direction::South, Direction::West} ){
+                uint64_t code = leaf.code;
+                if( ! step_code(code, depth, direction) ){
+                    continue;
+                }
+
+                // split every leaf on the way down, above (depth - 1)
+                Node* node = root.get();
+                for( size_t level = 1; level < depth; ++level ){
+                    node->split();
+                    node = child(*node, (code >> quadrant_shift(level)) & 3);
+                }
+            }
+        }
+    }
 }
 
 bool Tree::contains(const Eigen::Vector2d& p) const {
@@ -81,9 +317,10 @@ cell_value_t Tree::classify(const Eigen::Vector2d& p) const {
     // create a R/W copy, initialized at the tree's center.
     Eigen::Vector2d located( layout.get_center() );
 
+    double half_width = layout.get_half_width();
     auto current_node = root.get();
     
-    descend( p, located[0], located[1], layout.get_width(), current_node );
+    descend( p, located[0], located[1], half_width, current_node );
 
     return current_node->get_value();
 }
@@ -114,36 +351,167 @@ size_t Tree::calculate_complete_tree(const size_t height){
 
 double Tree::get_load_factor() const {
     const size_t height = root->get_height();
-    const size_t count = root->get_count();
+    const size_t count = root->get_unique_count();
     const size_t complete = calculate_complete_tree(height);
     return static_cast<double>(count) / static_cast<double>(complete);
 }
 
 size_t Tree::get_memory_usage() const {
-    return size() * sizeof(Node);
+    return root->get_memory_usage();
 }
 
-cell_value_t Tree::interp(const Eigen::Vector2d& at) const {
+BilinearCorners Tree::corners_around(const Vector2d& at) const {
+    // descend to the leaf containing `at`, recording the path down
+    struct Visited { Node* node; double x_c; double y_c; };
+    Visited path[Layout::index_bit_size/2 + 1];
+    size_t depth = 0;
+
+    double x_c = layout.get_x();
+    double y_c = layout.get_y();
+    double half_width = layout.get_half_width();
+    Node* node = root.get();
+    path[0] = {node, x_c, y_c};
+    while( ! node->is_leaf() ){
+        step( at, x_c, y_c, half_width, node);
+        path[++depth] = {node, x_c, y_c};
+    }
 
-    // cout << "@@" << at << "    near: " << near.get_bounds() << " = " << near.get_value() << endl;
+    // sample at this leaf's center, and at the points one leaf-width over from it, towards `at`:
+    // indexed [shifted along x][shifted along y].  Points outside the tree read from the nearest point inside.
+    const double dx = std::copysign(2*half_width, at.x() - x_c);
+    const double dy = std::copysign(2*half_width, at.y() - y_c);
+    const Vector2d probes[2][2] = { {{x_c, y_c}, {x_c, y_c + dy}}, {{x_c + dx, y_c}, {x_c + dx, y_c + dy}} };
+    Vector2d clamped[2][2];
+    for( size_t a = 0; a < 2; ++a ){
+        for( size_t b = 0; b < 2; ++b ){
+            clamped[a][b] = { layout.constrain_x(probes[a][b].x()), layout.constrain_y(probes[a][b].y()) };
+        }
+    }
+
+    // back up the path, to the lowest node that contains every probe; then branch out from there
+    const double x_min = layout.get_x_min();
+    const double y_min = layout.get_y_min();
+    size_t shared = depth;
+    double shared_half_width = half_width;
+    for( ; 0 < shared; --shared, shared_half_width *= 2 ){
+        const Visited& ancestor = path[shared];
+        const double x_lo = ancestor.x_c - shared_half_width;
+        const double y_lo = ancestor.y_c - shared_half_width;
+        bool covers = true;
+        for( size_t a = 0; a < 2; ++a ){
+            for( size_t b = 0; b < 2; ++b ){
+                // same tie-break as `descend`: a node owns its northern and eastern borders, but not its southern or
+                // western ones -- except along the tree's own border
+                const Vector2d& p = clamped[a][b];
+                covers = covers && ((x_lo < p.x()) || (x_lo <= x_min)) && (p.x() <= ancestor.x_c + shared_half_width)
+                                && ((y_lo < p.y()) || (y_lo <= y_min)) && (p.y() <= ancestor.y_c + shared_half_width);
+            }
+        }
+        if( covers ){
+            break;
+        }
+    }
 
-    // if Eigen::Vector2d is outside the tree, entirely
+    cell_value_t values[2][2];
+    for( size_t a = 0; a < 2; ++a ){
+        for( size_t b = 0; b < 2; ++b ){
+            double probe_x = path[shared].x_c;
+            double probe_y = path[shared].y_c;
+            double probe_half_width = shared_half_width;
+            Node* probe_node = path[shared].node;
+            descend( clamped[a][b], probe_x, probe_y, probe_half_width, probe_node);
+            values[a][b] = probe_node->get_value();
+        }
+    }
+
+    const size_t east = (0 < dx) ? 1 : 0;
+    const size_t north = (0 < dy) ? 1 : 0;
+    BilinearCorners corners;
+    corners.x_west = probes[1-east][0].x();
+    corners.x_east = probes[east][0].x();
+    corners.y_south = probes[0][1-north].y();
+    corners.y_north = probes[0][north].y();
+    corners.sw = values[1-east][1-north];
+    corners.se = values[east][1-north];
+    corners.nw = values[1-east][north];
+    corners.ne = values[east][north];
+    return corners;
+}
+
+cell_value_t Tree::interp(const Eigen::Vector2d& at) const {
     if( ! contains(at)){
         return cell_default_value;
     }
+    return interpolate_bilinear(at, corners_around(at));
+}
+
+void Tree::interp(const std::vector<Vector2d>& points, std::vector<cell_value_t>& values) const {
+    // points outside of the tree get a rectangle of nothing but the default value
+    const BilinearCorners outside = {0, 0, 0, 0, cell_default_value, cell_default_value, cell_default_value, cell_default_value};
+
+    BilinearBatch batch;
+    batch.resize(points.size());
+    util::parallel_for( points.size(), [&](const size_t begin, const size_t end){
+        for( size_t index = begin; index < end; ++index ){
+            const Vector2d& at = points[index];
+            batch.set(index, at, contains(at) ? corners_around(at) : outside);
+        }
+    }, 256);
+
+    interpolate_bilinear(batch, values);
+}
+
+std::optional<Sample> Tree::first_hit(const Vector2d& from, const Vector2d& to,
+                                      const std::function<bool(cell_value_t)>& predicate) const
+{
+    double t_enter, t_exit;
+    if( ! layout.clip(from, to, t_enter, t_exit) ){
+        return {};
+    }
 
-    // const Node& near = root->search(at, get_bounds());
-//     const Eigen::Vector2d& cn = near.get_center();
-//     const double dx = std::copysign(1.0, (at.x() - cn.x())) * 2 * near.get_bounds().half_width;
-//     const double dy = std::copysign(1.0, (at.y() - cn.y())) * 2 * near.get_bounds().half_width;
-//     const Node& n2 = root->search({cn.x() + dx, cn.y()     }, get_bounds());
-//     const Node& n3 = root->search({cn.x() + dx, cn.y() + dy}, get_bounds());
-//     const Node& n4 = root->search({cn.x()     , cn.y() + dy}, get_bounds());
+    const Vector2d delta = to - from;
+    const Vector2d center = layout.get_center();
+
+    double t = t_enter;
+    Vector2d at = from + t * delta;
+    while( true ){
+        // locate the leaf that the segment continues into, from `at`
+        double x_c = center[0];
+        double y_c = center[1];
+        double half_width = layout.get_half_width();
+        Node* current = root.get();
+        while( ! current->is_leaf() ){
+            step_towards( at, delta, x_c, y_c, half_width, current);
+        }
 
-//     const auto& interp = near.interpolate_bilinear(at, n2, n3, n4);
-    // return interp;
+        if( predicate(current->get_value()) ){
+            return Sample{at, current->get_value(), 2*half_width};
+        }
+
+        // skip the rest of this leaf: find where the segment leaves it
+        const double boundary_x = x_c + std::copysign(half_width, delta[0]);
+        const double boundary_y = y_c + std::copysign(half_width, delta[1]);
+        const double t_x = (0 == delta[0]) ? std::numeric_limits<double>::infinity() : (boundary_x - from[0]) / delta[0];
+        const double t_y = (0 == delta[1]) ? std::numeric_limits<double>::infinity() : (boundary_y - from[1]) / delta[1];
+        const double t_leave = std::min(t_x, t_y);
+        if( (t_exit <= t_leave) || (t_leave <= t) ){
+            return {};
+        }
 
-    return NAN;
+        // snap the crossed border(s) exactly, so the next descent resolves onto the far side
+        t = t_leave;
+        at = from + t * delta;
+        if( t_x <= t_y ){
+            at[0] = boundary_x;
+        }
+        if( t_y <= t_x ){
+            at[1] = boundary_y;
+        }
+    }
+}
+
+void Tree::compact(){
+    root->compact();
 }
 
 void Tree::fill(const cell_value_t fill_value){
@@ -167,6 +535,76 @@ void Tree::prune(){
     root->prune();
 }
 
+void Tree::leaves(const std::function<bool(cell_value_t)>& predicate, std::vector<Leaf>& found) const {
+    found.clear();
+    collect_leaves( *root, 0, 0, predicate, found);
+}
+
+Leaf Tree::locate(const Vector2d& p) const {
+    double x_c = layout.get_x();
+    double y_c = layout.get_y();
+    double half_width = layout.get_half_width();
+    const Node* node = root.get();
+
+    Leaf leaf = {0, 0};
+    while( ! node->is_leaf() ){
+        ++leaf.depth;
+        half_width *= 0.5;
+
+        // same tie-break as `descend`
+        const uint64_t quadrant = ((p.y() > y_c) ? 2 : 0) | ((p.x() > x_c) ? 1 : 0);
+        x_c += (quadrant & 1) ? half_width : -half_width;
+        y_c += (quadrant & 2) ? half_width : -half_width;
+
+        leaf.code |= quadrant << quadrant_shift(leaf.depth);
+        node = child(*node, quadrant);
+    }
+
+    return leaf;
+}
+
+void Tree::neighbors(const Leaf& leaf, const Direction direction, std::vector<Leaf>& found) const {
+    found.clear();
+
+    uint64_t code = leaf.code;
+    if( ! step_code(code, leaf.depth, direction) ){
+        return;
+    }
+
+    // descend towards the same-size neighbor; a larger leaf on the way is the only neighbor
+    const Node* node = root.get();
+    uint64_t prefix = 0;
+    size_t depth = 0;
+    while( (depth < leaf.depth) && (! node->is_leaf()) ){
+        ++depth;
+        const uint64_t quadrant = (code >> quadrant_shift(depth)) & 3;
+        prefix |= quadrant << quadrant_shift(depth);
+        node = child(*node, quadrant);
+    }
+
+    // ... otherwise, every leaf beneath the neighbor, along the side facing back towards `leaf`
+    static constexpr Direction facing[4] = { Direction::South, Direction::West, Direction::North, Direction::East };
+    collect_side( *node, prefix, depth, facing[static_cast<size_t>(direction)], found);
+}
+
+Occupancy Tree::query_box(const Vector2d& min, const Vector2d& max) const {
+    cell_value_t minimum = 0xFF;
+    cell_value_t maximum = 0;
+
+    // any part of the box outside of the tree reads as the default value
+    const bool overhangs = (min[0] < layout.get_x_min()) || (min[1] < layout.get_y_min())
+                        || (layout.get_x_max() < max[0]) || (layout.get_y_max() < max[1]);
+    if( overhangs ){
+        minimum = cell_default_value;
+        maximum = cell_default_value;
+    }
+
+    const Vector2d center = layout.get_center();
+    summarize_box( *root, center[0], center[1], layout.get_width(), min, max, minimum, maximum);
+
+    return classify_range(minimum, maximum);
+}
+
 void Tree::reset(){
     root = std::make_unique<Node>(0);
 }
@@ -178,25 +616,402 @@ void Tree::reset(const Layout& new_layout){
     root->split(layout.get_precision(), layout.get_width());
 }
 
+void Tree::reset(const Layout& new_layout, const cell_value_t fill_value){
+    layout = new_layout;
+
+    root = std::make_unique<Node>(fill_value);
+}
+
 Sample Tree::sample(const Eigen::Vector2d& p) const {
     Vector2d located( layout.get_center() );
+    double half_width = layout.get_half_width();
     auto current_node = root.get();
 
-    descend( p, located[0], located[1], layout.get_width(), current_node );
+    descend( p, located[0], located[1], half_width, current_node );
 
-    return {located, current_node->get_value()};
+    return {located, current_node->get_value(), 2*half_width};
+}
+
+Sample Tree::sample_leaf(const Leaf& leaf) const {
+    Vector2d center( layout.get_center() );
+    double half_width = layout.get_half_width();
+    const Node* node = root.get();
+
+    for( size_t depth = 1; depth <= leaf.depth; ++depth ){
+        const uint64_t quadrant = (leaf.code >> quadrant_shift(depth)) & 3;
+        half_width *= 0.5;
+        center[0] += (quadrant & 1) ? half_width : -half_width;
+        center[1] += (quadrant & 2) ? half_width : -half_width;
+        node = child(*node, quadrant);
+    }
+
+    return {center, node->get_value(), 2*half_width};
+}
+
+// paints the node's square of cells, [i0, i0+cells) x [j0, j0+cells), into a north-up image
+static void rasterize_node( const Node& node, const size_t i0, const size_t j0, const size_t cells,
+                            const size_t dimension, cell_value_t* buffer, const size_t stride)
+{
+    if( node.is_leaf() ){
+        for( size_t j = j0; j < j0 + cells; ++j ){
+            memset( buffer + (dimension - 1 - j) * stride + i0, node.get_value(), cells);
+        }
+        return;
+    }
+
+    const size_t half = cells / 2;
+    rasterize_node( *node.get_northeast(), i0 + half, j0 + half, half, dimension, buffer, stride);
+    rasterize_node( *node.get_northwest(), i0,        j0 + half, half, dimension, buffer, stride);
+    rasterize_node( *node.get_southwest(), i0,        j0,        half, dimension, buffer, stride);
+    rasterize_node( *node.get_southeast(), i0 + half, j0,        half, dimension, buffer, stride);
+}
+
+void Tree::rasterize_into(cell_value_t* buffer, const size_t stride) const {
+    const size_t dimension = layout.get_dimension();
+    rasterize_node( *root, 0, 0, dimension, dimension, buffer, stride);
+}
+
+void Tree::scan_row(const double y, std::vector<Run>& runs) const {
+    runs.clear();
+    if( (y < layout.get_y_min()) || (layout.get_y_max() < y) ){
+        return;
+    }
+
+    const Vector2d center = layout.get_center();
+    scan_node( *root, center[0], center[1], layout.get_half_width(), y, runs);
 }
 
 bool Tree::store(const Vector2d& p, const cell_value_t new_value) {
     Vector2d located( layout.get_center() );
     auto current_node = root.get();
 
-    descend( p, located[0], located[1], layout.get_width(), current_node );
+    // record the path down, so that the summaries above the leaf can be refreshed afterwards
+    Node* path[Layout::index_bit_size/2 + 1];
+    size_t depth = 0;
+
+    const double precision = layout.get_precision();
+    double next_width = layout.get_width()*0.5;
+    while( true ){
+        if( current_node->is_leaf() ){
+            if( new_value == current_node->get_value() ){
+                // already holds this value; nothing changes, and nothing needs splitting
+                return true;
+            }else if( (2*next_width) <= precision ){
+                break;
+            }
+        }
+
+        // split lazily, down to the single cell being written, so that only cell-sized leaves are ever written;
+        // and copy any child block still shared with another version.  (Another thread may win either race;
+        // either way, the node has children of its own afterwards.)
+        current_node->split();
+
+        path[depth++] = current_node;
+        step( p, located[0], located[1], next_width, current_node);
+    }
 
     current_node->set_value(new_value);
+
+    while( (0 < depth) && path[--depth]->update_summary_concurrent() ){}
+
     return true;
 }
 
+
+// after writing beneath `node`: collapses four equal leaf children back into `node`, or else refreshes its summary
+static void merge_or_summarize( Node& node ){
+    const Node& northeast = *node.get_northeast();
+    if( northeast.is_leaf() && node.get_northwest()->is_leaf() && node.get_southwest()->is_leaf() && node.get_southeast()->is_leaf() ){
+        const cell_value_t value = northeast.get_value();
+        if( (value == node.get_northwest()->get_value())
+                && (value == node.get_southwest()->get_value())
+                && (value == node.get_southeast()->get_value()) ){
+            node.reset();
+            node.set_value(value);
+            return;
+        }
+    }
+    node.update_summary();
+}
+
+// applies a Morton-sorted run of (key, payload) entries beneath `node`, which covers `cells` x `cells` cells.
+// `shift` locates this node's quadrant bits within each key.
+//   - `write(value, begin, end)` returns a cell's new value, from the entries that fall into it
+//   - `keep(value, begin, end)` may return true to leave a whole leaf as-is, without splitting it
+template<typename payload_t, typename write_t, typename keep_t>
+static void write_sorted( Node& node, const size_t cells, const size_t shift,
+                          const std::pair<uint64_t,payload_t>* begin, const std::pair<uint64_t,payload_t>* end,
+                          write_t& write, keep_t& keep)
+{
+    if( begin == end ){
+        return;
+    }
+
+    if( node.is_leaf() && keep(node.get_value(), begin, end) ){
+        return;
+    }
+
+    if( 1 == cells ){
+        node.set_value( write(node.get_value(), begin, end) );
+        return;
+    }
+
+    node.split();
+
+    // quadrants, in key order: (y-bit, x-bit) = SW, SE, NW, NE
+    Node* children[4] = { node.get_southwest(), node.get_southeast(), node.get_northwest(), node.get_northeast() };
+    const std::pair<uint64_t,payload_t>* cursor = begin;
+    for( uint64_t quadrant = 0; quadrant < 4; ++quadrant ){
+        const std::pair<uint64_t,payload_t>* stop = cursor;
+        while( (stop != end) && (quadrant == ((stop->first >> shift) & 3)) ){
+            ++stop;
+        }
+        write_sorted( *children[quadrant], cells / 2, shift - 2, cursor, stop, write, keep);
+        cursor = stop;
+    }
+
+    merge_or_summarize(node);
+}
+
+// Morton key of the cell containing `p`.  Cells are found with the same tie-break as `descend`:
+// a point exactly on a border belongs to the cell to its west / south.
+static uint64_t cell_key( const Layout& layout, const Vector2d& p ){
+    if( 1 == layout.get_dimension() ){
+        return 0;
+    }
+    const double i = std::max(0., std::ceil((p.x() - layout.get_x_min()) / layout.get_precision()) - 1);
+    const double j = std::max(0., std::ceil((p.y() - layout.get_y_min()) / layout.get_precision()) - 1);
+    return layout.zhash(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+}
+
+void Tree::integrate_scan(const Vector2d& origin, const std::vector<Vector2d>& endpoints){
+    const size_t dimension = layout.get_dimension();
+
+    // one (cell, change) entry per cell of every ray: misses along the way, and a hit where the ray ends
+    std::vector<std::pair<uint64_t,int>> updates;
+    for( const auto& endpoint : endpoints ){
+        const size_t first = updates.size();
+        layout.trace(origin, endpoint, [&](const uint32_t i, const uint32_t j, const double){
+            updates.emplace_back( (1 < dimension) ? layout.zhash(i, j) : 0, log_odds_miss);
+            return false;
+        });
+        if( (first < updates.size()) && layout.contains(endpoint) ){
+            updates.back().second = log_odds_hit;
+        }
+    }
+
+    // the sort is stable: each cell sees its updates in ray order, exactly as if the rays were applied one by one
+    util::radix_sort(updates);
+
+    auto write = [](cell_value_t value, const std::pair<uint64_t,int>* begin, const std::pair<uint64_t,int>* end){
+        for( auto* update = begin; update != end; ++update ){
+            value = update_log_odds(value, update->second);
+        }
+        return value;
+    };
+    // skip whole leaves that every update leaves unchanged (e.g. free space, already saturated free)
+    auto keep = [](const cell_value_t value, const std::pair<uint64_t,int>* begin, const std::pair<uint64_t,int>* end){
+        for( auto* update = begin; update != end; ++update ){
+            if( value != update_log_odds(value, update->second) ){
+                return false;
+            }
+        }
+        return true;
+    };
+
+    write_sorted( *root, dimension, Layout::index_bit_size - 2, updates.data(), updates.data() + updates.size(), write, keep);
+}
+
+void Tree::store_batch(const std::vector<Vector2d>& points, const std::vector<cell_value_t>& values){
+    if( points.size() != values.size() ){
+        throw std::invalid_argument("Tree::store_batch: expected one value per point");
+    }
+
+    std::vector<std::pair<uint64_t,size_t>> keys;
+    keys.reserve(points.size());
+    for( size_t index = 0; index < points.size(); ++index ){
+        if( contains(points[index]) ){
+            keys.emplace_back( cell_key(layout, points[index]), index);
+        }
+    }
+
+    util::radix_sort(keys);
+
+    // the sort is stable: the last write to a cell wins, as it would for sequential stores
+    auto write = [&](const cell_value_t, const std::pair<uint64_t,size_t>*, const std::pair<uint64_t,size_t>* end){
+        return values[(end - 1)->second];
+    };
+    // a leaf that already holds every value written into it needs no split
+    auto keep = [&](const cell_value_t value, const std::pair<uint64_t,size_t>* begin, const std::pair<uint64_t,size_t>* end){
+        for( auto* key = begin; key != end; ++key ){
+            if( value != values[key->second] ){
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // one depth-first pass: consecutive points share every node above their common quadrant
+    write_sorted( *root, layout.get_dimension(), Layout::index_bit_size - 2, keys.data(), keys.data() + keys.size(), write, keep);
+}
+
+// writes the part of the block [i0, i1) x [j0, j1) that overlaps the node's square of cells; merges equal leaves on the way out
+static void store_block_node( Node& node, const size_t node_i, const size_t node_j, const size_t cells,
+                              const size_t i0, const size_t j0, const size_t i1, const size_t j1,
+                              const cell_value_t* source, const size_t stride)
+{
+    if( (i1 <= node_i) || (node_i + cells <= i0) || (j1 <= node_j) || (node_j + cells <= j0) ){
+        // disjoint
+        return;
+    }
+
+    if( 1 == cells ){
+        // source rows run north-to-south
+        node.set_value( source[(j1 - 1 - node_j) * stride + (node_i - i0)] );
+        return;
+    }
+
+    node.split();
+
+    const size_t half = cells / 2;
+    store_block_node( *node.get_northeast(), node_i + half, node_j + half, half, i0, j0, i1, j1, source, stride);
+    store_block_node( *node.get_northwest(), node_i,        node_j + half, half, i0, j0, i1, j1, source, stride);
+    store_block_node( *node.get_southwest(), node_i,        node_j,        half, i0, j0, i1, j1, source, stride);
+    store_block_node( *node.get_southeast(), node_i + half, node_j,        half, i0, j0, i1, j1, source, stride);
+
+    merge_or_summarize(node);
+}
+
+// sets the part of the block [i0, i1) x [j0, j1) that overlaps the node's square of cells; merges equal leaves on the way out
+static void fill_block_node( Node& node, const size_t node_i, const size_t node_j, const size_t cells,
+                             const size_t i0, const size_t j0, const size_t i1, const size_t j1,
+                             const cell_value_t value)
+{
+    if( (i1 <= node_i) || (node_i + cells <= i0) || (j1 <= node_j) || (node_j + cells <= j0) ){
+        // disjoint
+        return;
+    }
+
+    if( (i0 <= node_i) && (node_i + cells <= i1) && (j0 <= node_j) && (node_j + cells <= j1) ){
+        // covered: whatever lies beneath is replaced by a single leaf
+        node.reset();
+        node.set_value(value);
+        return;
+    }
+
+    if( node.is_leaf() && (value == node.get_value()) ){
+        return;
+    }
+
+    node.split();
+
+    const size_t half = cells / 2;
+    fill_block_node( *node.get_northeast(), node_i + half, node_j + half, half, i0, j0, i1, j1, value);
+    fill_block_node( *node.get_northwest(), node_i,        node_j + half, half, i0, j0, i1, j1, value);
+    fill_block_node( *node.get_southwest(), node_i,        node_j,        half, i0, j0, i1, j1, value);
+    fill_block_node( *node.get_southeast(), node_i + half, node_j,        half, i0, j0, i1, j1, value);
+
+    merge_or_summarize(node);
+}
+
+// writes `source`, thresholded at `level`, into `out` (a leaf, on entry)
+static void threshold_node( const Node& source, const cell_value_t level, Node& out){
+    if( source.get_maximum() < level ){
+        out.set_value(0);
+        return;
+    }else if( level <= source.get_minimum() ){
+        out.set_value(0xFF);
+        return;
+    }
+
+    // the summary straddles `level`, so `source` has children
+    out.split();
+    threshold_node( *source.get_northeast(), level, *out.get_northeast());
+    threshold_node( *source.get_northwest(), level, *out.get_northwest());
+    threshold_node( *source.get_southwest(), level, *out.get_southwest());
+    threshold_node( *source.get_southeast(), level, *out.get_southeast());
+
+    merge_or_summarize(out);
+}
+
+void Tree::threshold(const cell_value_t level){
+    // built afresh beside the old version, so nodes shared with other versions are only read
+    Tree result(layout);
+    threshold_node( *root, level, *result.root);
+    root.swap(result.root);
+}
+
+void Tree::fill_block(const size_t i0, const size_t j0, const size_t width, const size_t height, const cell_value_t value){
+    fill_block_node( *root, 0, 0, layout.get_dimension(), i0, j0, i0 + width, j0 + height, value);
+}
+
+// merges `a` and `b`, which cover the same square, into `out` (a leaf, on entry)
+static void overlay_node( const Node& a, const Node& b, const Combine op, Node& out){
+    const cell_value_t a_min = a.get_minimum();
+    const cell_value_t a_max = a.get_maximum();
+    const cell_value_t b_min = b.get_minimum();
+    const cell_value_t b_max = b.get_maximum();
+
+    // wherever one side decides every cell, share that side's subtree as-is
+    switch(op){
+        case Combine::Union:
+            if( b_max <= a_min ){
+                out = a;
+                return;
+            }else if( a_max <= b_min ){
+                out = b;
+                return;
+            }
+            break;
+        case Combine::Intersection:
+            if( a_max <= b_min ){
+                out = a;
+                return;
+            }else if( b_max <= a_min ){
+                out = b;
+                return;
+            }
+            break;
+        case Combine::Overlay:
+            if( ! is_blocked(b_max) ){
+                out = a;
+                return;
+            }else if( is_blocked(b_min) ){
+                out = b;
+                return;
+            }
+            break;
+    }
+
+    // Neither side is uniform here (or the cases above would have decided), so at least one has children.
+    // A leaf stands in for all four of its own quadrants.
+    const bool a_whole = a.is_leaf();
+    const bool b_whole = b.is_leaf();
+    out.split();
+    overlay_node( a_whole ? a : *a.get_northeast(), b_whole ? b : *b.get_northeast(), op, *out.get_northeast());
+    overlay_node( a_whole ? a : *a.get_northwest(), b_whole ? b : *b.get_northwest(), op, *out.get_northwest());
+    overlay_node( a_whole ? a : *a.get_southwest(), b_whole ? b : *b.get_southwest(), op, *out.get_southwest());
+    overlay_node( a_whole ? a : *a.get_southeast(), b_whole ? b : *b.get_southeast(), op, *out.get_southeast());
+
+    merge_or_summarize(out);
+}
+
+Tree Tree::overlay(const Tree& a, const Tree& b, const Combine op){
+    if( a.layout != b.layout ){
+        throw std::invalid_argument("Tree::overlay: the two trees have different layouts");
+    }
+
+    Tree result(a.layout);
+    overlay_node( *a.root, *b.root, op, *result.root);
+    return result;
+}
+
+void Tree::store_block(const size_t i0, const size_t j0, const size_t width, const size_t height,
+                       const cell_value_t* source, const size_t stride)
+{
+    store_block_node( *root, 0, 0, layout.get_dimension(), i0, j0, i0 + width, j0 + height, source, stride);
+}
+
 size_t Tree::size() const {
     return root->get_count();
 }
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "delta/delta.hpp"
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "quadtree/tree.hpp"
+
+using Eigen::Vector2d;
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::Layout;
+
+namespace terrain::delta {
+
+static std::vector<cell_value_t> rasterize(const quadtree::Tree& tree){
+    const size_t dimension = tree.get_layout().get_dimension();
+    std::vector<cell_value_t> cells( dimension * dimension );
+    tree.rasterize_into(cells.data(), dimension);
+    return cells;
+}
+
+TEST(DeltaTest, DiffTreeVersions) {
+    const Layout layout(1., 32, 32, 64);
+    quadtree::Tree before;
+    before.reset(layout, 0);
+    before.fill_block(4, 4, 20, 12, 0x99);
+
+    // a later version shares everything it does not write
+    quadtree::Tree after(before);
+    EXPECT_TRUE( diff(before, after).empty() );
+
+    after.store({ 40.5, 50.5}, 0x99);
+    after.fill_block(8, 8, 4, 4, 0);
+    after.fill_block(32, 0, 32, 32, 7);
+
+    const Delta delta = diff(before, after);
+    ASSERT_FALSE( delta.empty() );
+    // the whole south-east quadrant changed at once
+    EXPECT_NE( std::find(delta.begin(), delta.end(), Change{32, 0, 32, 32, 7}), delta.end());
+
+    quadtree::Tree replica(before);
+    apply_delta(replica, delta);
+    EXPECT_EQ( rasterize(replica), rasterize(after));
+    EXPECT_TRUE( diff(replica, after).empty() );
+
+    // and back again
+    apply_delta(replica, diff(after, before));
+    EXPECT_EQ( rasterize(replica), rasterize(before));
+}
+
+TEST(DeltaTest, DiffTreeAgainstSplitTree) {
+    // one side pruned to a few leaves, the other fully split: only real changes appear
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree pruned;
+    pruned.reset(layout, 0);
+    quadtree::Tree split;
+    split.reset(layout);
+    split.store({ 3.5, 12.5}, 0x99);
+
+    const Delta delta = diff(pruned, split);
+    ASSERT_EQ( delta.size(), 1);
+    EXPECT_EQ( delta[0], (Change{3, 12, 1, 1, 0x99}));
+
+    apply_delta(pruned, delta);
+    EXPECT_EQ( rasterize(pruned), rasterize(split));
+}
+
+TEST(DeltaTest, DiffGrids) {
+    const Layout layout(1., 32, 32, 64);
+    grid::Grid before(layout);
+    before.fill(0);
+    grid::Grid after(before);
+
+    // a block becomes a single rectangle
+    std::vector<cell_value_t> block( 10 * 5, 0x99);
+    after.store_block(17, 40, 10, 5, block.data(), 10);
+    const Delta blocked = diff(before, after);
+    ASSERT_EQ( blocked.size(), 1);
+    EXPECT_EQ( blocked[0], (Change{17, 40, 10, 5, 0x99}));
+
+    // scattered writes
+    std::mt19937 generator(48);
+    std::uniform_real_distribution<double> coordinate(0., 64.);
+    std::uniform_int_distribution<int> value(0, 255);
+    for( int write = 0; write < 300; ++write ){
+        after.store({ coordinate(generator), coordinate(generator)}, static_cast<cell_value_t>(value(generator)));
+    }
+
+    const Delta delta = diff(before, after);
+    grid::Grid replica(before);
+    replica.build_pyramid();
+    apply_delta(replica, delta);
+    EXPECT_EQ( replica.storage, after.storage);
+    EXPECT_TRUE( diff(replica, after).empty() );
+    EXPECT_EQ( replica.query_box({ 17, 40}, { 27, 45}), after.query_box({ 17, 40}, { 27, 45}));
+}
+
+TEST(DeltaTest, DiffRejectsMismatchedLayouts) {
+    grid::Grid small({1., 8, 8, 16});
+    grid::Grid large({1., 16, 16, 32});
+    small.fill(0);
+    large.fill(0);
+    EXPECT_THROW( diff(small, large), std::invalid_argument);
+    EXPECT_THROW( diff(large, small), std::invalid_argument);
+    // same size, shifted
+    EXPECT_THROW( diff(small, grid::Grid({1., 9, 8, 16})), std::invalid_argument);
+
+    quadtree::Tree before;
+    before.reset({1., 8, 8, 16}, 0);
+    quadtree::Tree after;
+    after.reset({2., 8, 8, 16}, 0);
+    EXPECT_THROW( diff(before, after), std::invalid_argument);
+}
+
+} // namespace terrain::delta
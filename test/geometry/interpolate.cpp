@@ -1,4 +1,6 @@
 #include <cmath>
+#include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -97,4 +99,75 @@ TEST( InterpolateTest, InterpolateQuad){
     }
 }
 
+TEST( InterpolateTest, InterpolateBatch){
+    // the same quad as above, at several points; plus a few beyond the rectangle
+    const std::vector<Eigen::Vector2d> points = { {5, 1}, {1, 1}, {8, 8}, {0, 0}, {10, 10}, {5, 5}, {-3, 5}, {5, 14}, {12, -1} };
+    const std::vector<cell_value_t> expected = { 30,     10,     80,     0,      100,      50,     25,      75,      50 };
+
+    BilinearBatch batch;
+    batch.resize(points.size());
+    for( size_t index = 0; index < points.size(); ++index ){
+        batch.x[index] = points[index].x();
+        batch.y[index] = points[index].y();
+        batch.x_west[index] = 0;
+        batch.x_east[index] = 10;
+        batch.y_south[index] = 0;
+        batch.y_north[index] = 10;
+        batch.sw[index] = 0;
+        batch.se[index] = 50;
+        batch.nw[index] = 50;
+        batch.ne[index] = 100;
+    }
+
+    std::vector<cell_value_t> values;
+    interpolate_bilinear(batch, values);
+    ASSERT_EQ( values, expected);
+
+    // a zero-width rectangle collapses onto its west side
+    batch.x_east[0] = 0;
+    interpolate_bilinear(batch, values);
+    EXPECT_EQ( values[0], 5);
+}
+
+TEST( InterpolateTest, InterpolateBatchMatchesScalar){
+    std::mt19937 generator(43);
+    std::uniform_real_distribution<double> coordinate(-100., 100.);
+    std::uniform_real_distribution<double> fraction(0., 1.);
+    std::uniform_int_distribution<int> value(0, 255);
+
+    // an odd count, so that the vector lanes leave a tail
+    const size_t count = 10007;
+    BilinearBatch batch;
+    batch.resize(count);
+    for( size_t index = 0; index < count; ++index ){
+        const double x0 = coordinate(generator);
+        const double y0 = coordinate(generator);
+        const double width = 1 + fraction(generator) * 20;
+        batch.x_west[index] = x0;
+        batch.x_east[index] = x0 + width;
+        batch.y_south[index] = y0;
+        batch.y_north[index] = y0 + width;
+        batch.x[index] = x0 + fraction(generator) * width;
+        batch.y[index] = y0 + fraction(generator) * width;
+        batch.sw[index] = value(generator);
+        batch.se[index] = value(generator);
+        batch.nw[index] = value(generator);
+        batch.ne[index] = value(generator);
+    }
+
+    std::vector<cell_value_t> values;
+    interpolate_bilinear(batch, values);
+    ASSERT_EQ( values.size(), count);
+
+    for( size_t index = 0; index < count; ++index ){
+        const Sample ne = {{batch.x_east[index], batch.y_north[index]}, batch.ne[index]};
+        const Sample nw = {{batch.x_west[index], batch.y_north[index]}, batch.nw[index]};
+        const Sample sw = {{batch.x_west[index], batch.y_south[index]}, batch.sw[index]};
+        const Sample se = {{batch.x_east[index], batch.y_south[index]}, batch.se[index]};
+        // the same weights, and the same single rounding
+        ASSERT_EQ( interpolate_bilinear({batch.x[index], batch.y[index]}, ne, nw, sw, se), values[index])
+            << "    @ entry: " << index;
+    }
+}
+
 } // namespace terrain::geometry
@@ -277,3 +277,27 @@ TEST(LayoutTest, HashBy_ZOrderCurve) {
     ASSERT_EQ( layout.zhash(2.5, 3.5), 0xe000000000000000);
     ASSERT_EQ( layout.zhash(3.5, 3.5), 0xf000000000000000);
 }
+
+TEST(LayoutTest, ClipSegment) {
+    Layout layout(1,  2,  2, 4);
+    double t_enter, t_exit;
+
+    // fully inside
+    ASSERT_TRUE( layout.clip({1, 1}, {3, 2}, t_enter, t_exit));
+    EXPECT_DOUBLE_EQ( t_enter, 0.);
+    EXPECT_DOUBLE_EQ( t_exit,  1.);
+
+    // crossing the whole layout, in x
+    ASSERT_TRUE( layout.clip({-4, 1}, {8, 1}, t_enter, t_exit));
+    EXPECT_DOUBLE_EQ( t_enter, 1./3);
+    EXPECT_DOUBLE_EQ( t_exit,  2./3);
+
+    // diagonally, through the corner region
+    ASSERT_TRUE( layout.clip({-1, -1}, {1, 1}, t_enter, t_exit));
+    EXPECT_DOUBLE_EQ( t_enter, 0.5);
+    EXPECT_DOUBLE_EQ( t_exit,  1.);
+
+    // misses
+    EXPECT_FALSE( layout.clip({-1, 5}, {5, 5}, t_enter, t_exit));
+    EXPECT_FALSE( layout.clip({-2, 3}, {3, 8}, t_enter, t_exit));
+}
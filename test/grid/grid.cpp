@@ -1,15 +1,29 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#ifdef ENABLE_GDAL
+#include "gdal.h"
+#include "gdal_priv.h"
+#endif
+
 #include "nlohmann/json/json.hpp"
 
 #include "geometry/layout.hpp"
 #include "geometry/polygon.hpp"
 
 #include "grid/grid.hpp"
+#include "quadtree/tree.hpp"
 #include "terrain.hpp"
 #include "io/readers.hpp"
 #include "io/writers.hpp"
@@ -341,6 +355,184 @@ TEST(GridTest, LoadOffsetPolygon) {
     
 }
 
+TEST(GridTest, LoadPointCloud) {
+    Grid g({1., 8, 8, 16});
+    Terrain terrain(g);
+    g.fill(0);
+
+    // x, y, z: two tall points share a cell; the others are too low, outside, or not-a-number
+    const std::vector<float> cloud = {  2.5f,  3.5f, 1.8f,
+                                        2.9f,  3.1f, 2.2f,
+                                       10.2f, 12.7f, 0.9f,
+                                        5.5f,  5.5f, 0.2f,
+                                       -4.0f,  5.5f, 3.0f,
+                                        6.5f,  6.5f, NAN};
+    const string raw_path("test.points.xyz");
+    {
+        std::ofstream sink(raw_path, std::ios::binary);
+        sink.write(reinterpret_cast<const char*>(cloud.data()), cloud.size() * sizeof(float));
+    }
+    ASSERT_TRUE( terrain::io::load_points_from_file(terrain, raw_path, 0.5));
+    std::remove(raw_path.c_str());
+
+    EXPECT_EQ( terrain.classify({ 2.5,  3.5}), 0x99);
+    EXPECT_EQ( terrain.classify({10.5, 12.5}), 0x99);
+    EXPECT_EQ( terrain.classify({ 5.5,  5.5}), 0);
+    EXPECT_EQ( terrain.classify({ 6.5,  6.5}), 0);
+    EXPECT_EQ( g.count_blocked({0,0}, {16,16}), 2);
+
+    // the same cloud, as a PCD file with an extra leading field
+    const string pcd_path("test.points.pcd");
+    {
+        std::ofstream sink(pcd_path, std::ios::binary);
+        sink << "# .PCD v0.7 - Point Cloud Data file format\n"
+             << "VERSION 0.7\nFIELDS intensity x y z\nSIZE 2 4 4 4\nTYPE U F F F\nCOUNT 1 1 1 1\n"
+             << "WIDTH 6\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS 6\nDATA binary\n";
+        for( size_t point = 0; point < cloud.size(); point += 3 ){
+            const uint16_t intensity = 7;
+            sink.write(reinterpret_cast<const char*>(&intensity), sizeof(intensity));
+            sink.write(reinterpret_cast<const char*>(&cloud[point]), 3 * sizeof(float));
+        }
+    }
+    g.fill(0);
+    ASSERT_TRUE( terrain::io::load_points_from_file(terrain, pcd_path, 1.0));
+    std::remove(pcd_path.c_str());
+
+    EXPECT_EQ( terrain.classify({ 2.5,  3.5}), 0x99);
+    EXPECT_EQ( terrain.classify({10.5, 12.5}), 0);
+    EXPECT_EQ( g.count_blocked({0,0}, {16,16}), 1);
+
+    EXPECT_FALSE( terrain::io::load_points_from_file(terrain, "no-such-file.pcd", 1.0));
+}
+
+TEST(GridTest, StoreBatchReadsBackWithClassify) {
+    Grid g({1., 8, 8, 16});
+    g.fill(0);
+
+    // interior cell corners and edges, then the west, south, east and north borders, and the layout's corners
+    const std::vector<Vector2d> points = {{8., 8.}, {3., 5.5}, {12.5, 4.},
+                                          {0., 9.5}, {6.5, 0.}, {16., 2.5}, {10.5, 16.},
+                                          {0., 0.}, {16., 0.}, {0., 16.}, {16., 16.}};
+    std::vector<cell_value_t> values;
+    for( size_t index = 0; index < points.size(); ++index ){
+        values.push_back(static_cast<cell_value_t>(index + 1));
+    }
+    g.store_batch(points, values);
+
+    for( size_t index = 0; index < points.size(); ++index ){
+        EXPECT_EQ( g.classify(points[index]), values[index]) << "    for point: " << index;
+    }
+
+    // an edge point lands east / north of the line; a border point in the last column / row
+    EXPECT_EQ( g.get_cell( 8,  8), 1);
+    EXPECT_EQ( g.get_cell( 3,  5), 2);
+    EXPECT_EQ( g.get_cell(12,  4), 3);
+    EXPECT_EQ( g.get_cell(15,  2), 6);
+    EXPECT_EQ( g.get_cell(10, 15), 7);
+    EXPECT_EQ( g.get_cell(15, 15), 11);
+
+    // nothing wrapped around: every other cell is untouched
+    std::vector<cell_value_t> raster( 16 * 16 );
+    g.rasterize_into(raster.data(), 16);
+    EXPECT_EQ( std::count(raster.begin(), raster.end(), 0), 256 - static_cast<long>(points.size()));
+
+    // and `store` agrees, point by point
+    Grid one_by_one({1., 8, 8, 16});
+    one_by_one.fill(0);
+    for( size_t index = 0; index < points.size(); ++index ){
+        one_by_one.store(points[index], values[index]);
+    }
+    std::vector<cell_value_t> expected( 16 * 16 );
+    one_by_one.rasterize_into(expected.data(), 16);
+    EXPECT_EQ( raster, expected);
+}
+
+TEST(GridTest, IntegrateScan) {
+    using terrain::geometry::log_odds_unknown;
+    using terrain::geometry::log_odds_hit;
+    using terrain::geometry::log_odds_miss;
+
+    Grid g({1., 8, 8, 16});
+    g.fill(log_odds_unknown);
+    g.build_pyramid();
+
+    // one ray east along the row y=[2,3), ending in the cell x=[5,6); one ray leaving the grid
+    g.integrate_scan({0.5, 2.5}, {{5.5, 2.5}, {0.5, 20.}});
+
+    for( int x = 1; x < 5; ++x ){
+        EXPECT_EQ( g.classify({x + 0.5, 2.5}), log_odds_unknown + log_odds_miss) << "    @ x=" << x;
+    }
+    EXPECT_EQ( g.classify({5.5, 2.5}), log_odds_unknown + log_odds_hit);
+    EXPECT_EQ( g.classify({6.5, 2.5}), log_odds_unknown);
+    // the origin's own cell is crossed by both rays
+    EXPECT_EQ( g.classify({0.5, 2.5}), log_odds_unknown + 2*log_odds_miss);
+    EXPECT_EQ( g.classify({0.5, 15.5}), log_odds_unknown + log_odds_miss);
+
+    // repeated scans saturate, rather than wrapping around
+    for( int scan = 0; scan < 100; ++scan ){
+        g.integrate_scan({0.5, 2.5}, {{5.5, 2.5}});
+    }
+    EXPECT_EQ( g.classify({2.5, 2.5}), 0);
+    EXPECT_EQ( g.classify({5.5, 2.5}), 0xFF);
+    EXPECT_TRUE( terrain::geometry::is_occupied(g.classify({5.5, 2.5})) );
+
+    // the pyramid followed along
+    EXPECT_EQ( g.query_box({1, 2}, {5, 3}), Occupancy::Free);
+}
+
+TEST(GridTest, PublishSnapshots) {
+    Grid g({1., 8, 8, 16});
+    g.build_pyramid();
+    g.fill(0);
+    Terrain<Grid> terrain(g);
+    EXPECT_FALSE( terrain.snapshot() );
+
+    terrain.publish();
+    auto first = terrain.snapshot();
+    ASSERT_TRUE( first );
+    EXPECT_NE( first.get(), &g );
+
+    // later writes do not show through to an already-published version
+    g.fill(0x99);
+    EXPECT_EQ( first->classify({3.5, 3.5}), 0);
+    EXPECT_EQ( first->query_box({0, 0}, {16, 16}), Occupancy::Free);
+    terrain.publish();
+    EXPECT_EQ( terrain.snapshot()->classify({3.5, 3.5}), 0x99);
+    EXPECT_EQ( terrain.snapshot()->query_box({0, 0}, {16, 16}), Occupancy::Blocked);
+    EXPECT_EQ( first->classify({3.5, 3.5}), 0);
+
+    // the terrain itself lets go of each version once the next one is published
+    const std::weak_ptr<const Grid> released(first);
+    first.reset();
+    EXPECT_TRUE( released.expired() );
+
+    // readers never see a half-written version: every version holds one value, throughout
+    std::atomic<bool> done(false);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> readers;
+    for( int reader = 0; reader < 4; ++reader ){
+        readers.emplace_back([&](){
+            while( ! done ){
+                const auto version = terrain.snapshot();
+                const cell_value_t value = version->classify({0.5, 0.5});
+                for( double x = 0.5; x < 16; x += 1 ){
+                    mismatches += (value == version->classify({x, 15.5 - x})) ? 0 : 1;
+                }
+            }
+        });
+    }
+    for( int version = 0; version < 200; ++version ){
+        g.fill(static_cast<cell_value_t>(version));
+        terrain.publish();
+    }
+    done = true;
+    for( auto& reader : readers ){
+        reader.join();
+    }
+    EXPECT_EQ( mismatches, 0);
+    EXPECT_EQ( terrain.snapshot()->classify({8.5, 8.5}), 199);
+}
+
 TEST(GridTest, LoadSomervilleShapeFile) {
     Terrain<Grid> terrain;
 
@@ -364,6 +556,296 @@ TEST(GridTest, LoadSomervilleShapeFile) {
     ASSERT_TRUE( load_result );
 }
 
+#ifdef ENABLE_GDAL
+///! \brief reads back the first band of a (square) image file, or returns an empty vector
+static std::vector<cell_value_t> read_image(const std::filesystem::path& path, const size_t image_width){
+    auto * dataset = (GDALDataset*) GDALOpenEx( path.c_str(), GDAL_OF_RASTER, NULL, NULL, NULL );
+    if( nullptr == dataset ){
+        return {};
+    }
+
+    std::vector<cell_value_t> pixels( image_width * image_width );
+    const bool success = (image_width == static_cast<size_t>(dataset->GetRasterXSize()))
+                      && (image_width == static_cast<size_t>(dataset->GetRasterYSize()))
+                      && (CE_None == dataset->GetRasterBand(1)->RasterIO( GF_Read, 0, 0, image_width, image_width, pixels.data(),
+                                                                         image_width, image_width, GDT_Byte, 0, 0));
+    GDALClose( dataset );
+    return success ? pixels : std::vector<cell_value_t>();
+}
+
+///! \brief writes a 32x32 terrain as 8x8 tiles, and checks the files and the downsampled pixels
+template<typename terrain_t>
+static void check_tile_pyramid(terrain_t& terrain, const std::filesystem::path& directory){
+    terrain.reset({1., 16, 16, 32}, 0);
+
+    // a gentle gradient, everywhere below the lone obstacle's value
+    std::vector<cell_value_t> cells( 32 * 32 );
+    for( size_t row = 0; row < 32; ++row ){
+        for( size_t column = 0; column < 32; ++column ){
+            cells[row*32 + column] = static_cast<cell_value_t>((3*row + 7*column) % 40);
+        }
+    }
+    // the lone obstacle: image row 9 is cell row 22, counting from the south
+    cells[9*32 + 5] = 0x99;
+    terrain.impl.store_block(0, 0, 32, 32, cells.data(), 32);
+
+    std::vector<cell_value_t> source( 32 * 32 );
+    terrain.impl.rasterize_into(source.data(), 32);
+    ASSERT_EQ( source, cells);
+
+    std::filesystem::remove_all(directory);
+    ASSERT_TRUE( terrain::io::to_tiles(terrain, directory.string(), 8) );
+
+    // zoom 0 is a single tile; the finest zoom, 2, shows one pixel per cell
+    for( size_t zoom = 0; zoom <= 2; ++zoom ){
+        const size_t tiles_per_side = size_t(1) << zoom;
+        for( size_t x = 0; x < tiles_per_side; ++x ){
+            for( size_t y = 0; y < tiles_per_side; ++y ){
+                const auto tile = directory / std::to_string(zoom) / std::to_string(x) / (std::to_string(y) + ".png");
+                EXPECT_TRUE( std::filesystem::exists(tile) ) << "    missing tile: " << tile;
+            }
+        }
+    }
+    EXPECT_FALSE( std::filesystem::exists(directory / "3") );
+
+    // finest zoom: tile (x=1, y=0) is the north-east corner of the source, unchanged
+    const auto finest = read_image(directory / "2" / "1" / "0.png", 8);
+    ASSERT_EQ( finest.size(), 64);
+    for( size_t row = 0; row < 8; ++row ){
+        for( size_t column = 0; column < 8; ++column ){
+            ASSERT_EQ( finest[row*8 + column], source[row*32 + 8 + column]);
+        }
+    }
+
+    // zoom 1: tile (x=0, y=0) is the north-west quarter; each pixel is the largest of its 2x2 block of cells
+    const auto coarse = read_image(directory / "1" / "0" / "0.png", 8);
+    ASSERT_EQ( coarse.size(), 64);
+    for( size_t row = 0; row < 8; ++row ){
+        for( size_t column = 0; column < 8; ++column ){
+            const cell_value_t expected = std::max( std::max(source[(2*row)*32 + 2*column], source[(2*row)*32 + 2*column + 1]),
+                                                    std::max(source[(2*row+1)*32 + 2*column], source[(2*row+1)*32 + 2*column + 1]));
+            ASSERT_EQ( coarse[row*8 + column], expected) << "    @ row: " << row << "  column: " << column;
+        }
+    }
+    EXPECT_EQ( coarse[4*8 + 2], 0x99);
+
+    // zoom 0: each pixel covers 4x4 cells, and the lone obstacle still shows
+    const auto whole = read_image(directory / "0" / "0" / "0.png", 8);
+    ASSERT_EQ( whole.size(), 64);
+    for( size_t row = 0; row < 8; ++row ){
+        for( size_t column = 0; column < 8; ++column ){
+            cell_value_t expected = 0;
+            for( size_t cell_row = 4*row; cell_row < 4*row + 4; ++cell_row ){
+                for( size_t cell_column = 4*column; cell_column < 4*column + 4; ++cell_column ){
+                    expected = std::max(expected, source[cell_row*32 + cell_column]);
+                }
+            }
+            ASSERT_EQ( whole[row*8 + column], expected) << "    @ row: " << row << "  column: " << column;
+        }
+    }
+    EXPECT_EQ( whole[2*8 + 1], 0x99);
+    EXPECT_LT( whole[2*8 + 2], 0x99);
+
+    // a tile wider than the terrain is clamped: one level, one tile, one pixel per cell
+    std::filesystem::remove_all(directory);
+    ASSERT_TRUE( terrain::io::to_tiles(terrain, directory.string(), 64) );
+    EXPECT_EQ( read_image(directory / "0" / "0" / "0.png", 32), source);
+    EXPECT_FALSE( std::filesystem::exists(directory / "1") );
+
+    // tile widths must be powers of 2
+    EXPECT_FALSE( terrain::io::to_tiles(terrain, directory.string(), 0) );
+    EXPECT_FALSE( terrain::io::to_tiles(terrain, directory.string(), 12) );
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(GridTest, WriteTilesFromGrid) {
+    Terrain<Grid> terrain;
+    check_tile_pyramid(terrain, std::filesystem::temp_directory_path() / "grid.test.tiles");
+}
+
+TEST(GridTest, WriteTilesFromTree) {
+    Terrain<quadtree::Tree> terrain;
+    check_tile_pyramid(terrain, std::filesystem::temp_directory_path() / "tree.test.tiles");
+}
+
+TEST(GridTest, WriteGeoTIFF) {
+    Terrain<quadtree::Tree> terrain;
+    terrain.reset({4., -200, 600, 64}, 0);
+    terrain.impl.store({-222., 622.}, 0x99);
+    terrain.impl.store({-177., 577.}, 7);
+
+    const auto path = std::filesystem::temp_directory_path() / "write.test.tif";
+    ASSERT_TRUE( terrain::io::to_geotiff(terrain, path.string()) );
+
+    auto * dataset = (GDALDataset*) GDALOpenEx( path.c_str(), GDAL_OF_RASTER, NULL, NULL, NULL );
+    ASSERT_NE( dataset, nullptr);
+    EXPECT_EQ( dataset->GetRasterXSize(), 16);
+    EXPECT_EQ( dataset->GetRasterYSize(), 16);
+
+    // north-up: the origin is the north-west corner, and each pixel is one cell wide
+    double geo_transform[6];
+    ASSERT_EQ( dataset->GetGeoTransform(geo_transform), CE_None);
+    EXPECT_DOUBLE_EQ( geo_transform[0], -232.);
+    EXPECT_DOUBLE_EQ( geo_transform[1],    4.);
+    EXPECT_DOUBLE_EQ( geo_transform[2],    0.);
+    EXPECT_DOUBLE_EQ( geo_transform[3],  632.);
+    EXPECT_DOUBLE_EQ( geo_transform[4],    0.);
+    EXPECT_DOUBLE_EQ( geo_transform[5],   -4.);
+    GDALClose( dataset );
+
+    std::vector<cell_value_t> expected( 16 * 16 );
+    terrain.impl.rasterize_into(expected.data(), 16);
+    const auto pixels = read_image(path, 16);
+    EXPECT_EQ( pixels, expected);
+
+    // the blocked cell sits 2 columns in from the west, and 2 rows down from the north
+    ASSERT_EQ( pixels.size(), 256);
+    EXPECT_EQ( pixels[2*16 + 2],  0x99);
+    EXPECT_EQ( pixels[13*16 + 13],   7);
+    EXPECT_EQ( pixels[0],            0);
+
+    std::filesystem::remove(path);
+}
+
+///! \brief writes a single-band byte raster, with the given geotransform, as a GeoTIFF file
+static bool write_raster(const std::filesystem::path& path, const size_t raster_width, const size_t raster_height,
+                         double geo_transform[6], std::vector<cell_value_t>& pixels)
+{
+    GDALDriver* p_tiff_driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    GDALDataset *p_dataset = p_tiff_driver->Create(path.c_str(), raster_width, raster_height, 1, GDT_Byte, nullptr);
+    if( nullptr == p_dataset ){
+        return false;
+    }
+    p_dataset->SetGeoTransform(geo_transform);
+    const bool success = (CE_None == p_dataset->GetRasterBand(1)->RasterIO( GF_Write, 0, 0, raster_width, raster_height, pixels.data(),
+                                                                           raster_width, raster_height, GDT_Byte, 0, 0));
+    GDALClose( p_dataset );
+    return success;
+}
+
+///! \brief saves `source` as a GeoTIFF, then loads it back into both backends, and compares every cell
+template<typename terrain_t>
+static void check_raster_round_trip(terrain_t& source, const std::filesystem::path& path){
+    source.reset({2., 100, -40, 64}, 0);
+
+    // open water, a few random obstacles, and one solid block
+    std::mt19937 generator(33);
+    std::uniform_int_distribution<int> value(0, 0xFF);
+    std::vector<cell_value_t> cells( 32 * 32, 0);
+    for( auto& cell : cells ){
+        const int draw = value(generator);
+        cell = (0xF0 < draw) ? static_cast<cell_value_t>(draw) : 0;
+    }
+    for( size_t row = 20; row < 28; ++row ){
+        std::fill( cells.begin() + row*32 + 4, cells.begin() + row*32 + 12, 0x99);
+    }
+    source.impl.store_block(0, 0, 32, 32, cells.data(), 32);
+
+    ASSERT_TRUE( terrain::io::to_geotiff(source, path.string()) );
+
+    Terrain<Grid> to_grid;
+    Terrain<quadtree::Tree> to_tree;
+    ASSERT_TRUE( terrain::io::load_raster_from_file(to_grid, path.string()) ) << to_grid.error_message;
+    ASSERT_TRUE( terrain::io::load_raster_from_file(to_tree, path.string()) ) << to_tree.error_message;
+
+    // the layout is recovered from the geotransform alone
+    for( const auto* layout : { &to_grid.get_layout(), &to_tree.get_layout() }){
+        EXPECT_DOUBLE_EQ( layout->get_precision(),  2.);
+        EXPECT_DOUBLE_EQ( layout->get_x(),        100.);
+        EXPECT_DOUBLE_EQ( layout->get_y(),        -40.);
+        EXPECT_DOUBLE_EQ( layout->get_width(),     64.);
+        EXPECT_EQ( layout->get_dimension(),        32);
+    }
+
+    std::vector<cell_value_t> from_grid( 32 * 32 );
+    std::vector<cell_value_t> from_tree( 32 * 32 );
+    to_grid.impl.rasterize_into(from_grid.data(), 32);
+    to_tree.impl.rasterize_into(from_tree.data(), 32);
+    EXPECT_EQ( from_grid, cells);
+    EXPECT_EQ( from_tree, cells);
+
+    // image row 0 is the northern edge
+    EXPECT_EQ( to_grid.classify({ 79., -49.}), 0x99);
+    EXPECT_EQ( to_tree.classify({ 79., -49.}), 0x99);
+
+    std::filesystem::remove(path);
+}
+
+TEST(GridTest, RasterRoundTripFromGrid) {
+    Terrain<Grid> source;
+    check_raster_round_trip(source, std::filesystem::temp_directory_path() / "grid.test.tif");
+}
+
+TEST(GridTest, RasterRoundTripFromTree) {
+    Terrain<quadtree::Tree> source;
+    check_raster_round_trip(source, std::filesystem::temp_directory_path() / "tree.test.tif");
+}
+
+TEST(GridTest, LoadPaddedRaster) {
+    const auto path = std::filesystem::temp_directory_path() / "padded.test.tif";
+
+    // 300 x 200 pixels: padded out to a 512 x 512 layout, anchored at the north-west corner
+    std::vector<cell_value_t> pixels( 300 * 200 );
+    for( size_t row = 0; row < 200; ++row ){
+        for( size_t column = 0; column < 300; ++column ){
+            pixels[row*300 + column] = static_cast<cell_value_t>((row + 3*column) % 50);
+        }
+    }
+    double geo_transform[6] = { 500, 1, 0, 1000, 0, -1 };
+    ASSERT_TRUE( write_raster(path, 300, 200, geo_transform, pixels) );
+
+    Terrain<Grid> grid_terrain;
+    Terrain<quadtree::Tree> tree_terrain;
+    ASSERT_TRUE( terrain::io::load_raster_from_file(grid_terrain, path.string()) ) << grid_terrain.error_message;
+    ASSERT_TRUE( terrain::io::load_raster_from_file(tree_terrain, path.string()) ) << tree_terrain.error_message;
+
+    EXPECT_DOUBLE_EQ( grid_terrain.get_layout().get_x_min(),  500.);
+    EXPECT_DOUBLE_EQ( grid_terrain.get_layout().get_y_max(), 1000.);
+    EXPECT_EQ( grid_terrain.get_layout().get_dimension(),     512);
+    EXPECT_TRUE( grid_terrain.get_layout() == tree_terrain.get_layout() );
+
+    std::vector<cell_value_t> from_grid( 512 * 512 );
+    std::vector<cell_value_t> from_tree( 512 * 512 );
+    grid_terrain.impl.rasterize_into(from_grid.data(), 512);
+    tree_terrain.impl.rasterize_into(from_tree.data(), 512);
+    for( size_t row = 0; row < 512; ++row ){
+        for( size_t column = 0; column < 512; ++column ){
+            // the padding, to the east and south of the raster, reads as blocked
+            const bool inside = (row < 200) && (column < 300);
+            const cell_value_t expected = inside ? pixels[row*300 + column] : terrain::io::block_value;
+            ASSERT_EQ( from_grid[row*512 + column], expected) << "    @ row: " << row << "  column: " << column;
+            ASSERT_EQ( from_tree[row*512 + column], expected) << "    @ row: " << row << "  column: " << column;
+        }
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(GridTest, RejectUnsupportedRasters) {
+    const auto path = std::filesystem::temp_directory_path() / "rejected.test.tif";
+    std::vector<cell_value_t> pixels( 16 * 16, 0);
+    Terrain<Grid> terrain;
+
+    double rotated[6] = { 0, 1, 0.25, 16, 0, -1 };
+    ASSERT_TRUE( write_raster(path, 16, 16, rotated, pixels) );
+    EXPECT_FALSE( terrain::io::load_raster_from_file(terrain, path.string()) );
+
+    double stretched[6] = { 0, 1, 0, 16, 0, -2 };
+    ASSERT_TRUE( write_raster(path, 16, 16, stretched, pixels) );
+    EXPECT_FALSE( terrain::io::load_raster_from_file(terrain, path.string()) );
+
+    // 3m pixels would snap to a 2m precision
+    double coarse[6] = { 0, 3, 0, 48, 0, -3 };
+    ASSERT_TRUE( write_raster(path, 16, 16, coarse, pixels) );
+    EXPECT_FALSE( terrain::io::load_raster_from_file(terrain, path.string()) );
+    EXPECT_FALSE( terrain.error_message.empty() );
+
+    std::filesystem::remove(path);
+    EXPECT_FALSE( terrain::io::load_raster_from_file(terrain, path.string()) );
+}
+#endif //#ifdef ENABLE_GDAL
+
 // TEST(GridTest, LoadMassachusettsShapeFile) {
 //     Terrain<Grid> terrain;
 
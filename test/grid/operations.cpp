@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "grid/operations.hpp"
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::Layout;
+using terrain::geometry::Occupancy;
+
+namespace terrain::grid {
+
+static void randomize(Grid& g, std::mt19937& generator){
+    std::uniform_int_distribution<int> value(0, 255);
+    for( cell_value_t& cell : g.storage ){
+        cell = static_cast<cell_value_t>(value(generator));
+    }
+}
+
+TEST(OperationsTest, CombineMatchesScalar) {
+    // 100 cells per row: not a multiple of the vector width, so the scalar tail runs too
+    const Layout layout(1., 50, 50, 100);
+    std::mt19937 generator(50);
+    Grid a(layout);
+    Grid b(layout);
+    randomize(a, generator);
+    randomize(b, generator);
+
+    for( const Operation op : {Operation::And, Operation::Or, Operation::Max, Operation::Min, Operation::AddSaturated} ){
+        Grid result(a);
+        combine(result, b, op);
+
+        for( size_t index = 0; index < a.storage.size(); ++index ){
+            const int x = a.storage[index];
+            const int y = b.storage[index];
+            int expected = 0;
+            switch(op){
+                case Operation::And:          expected = x & y;                 break;
+                case Operation::Or:           expected = x | y;                 break;
+                case Operation::Max:          expected = std::max(x, y);        break;
+                case Operation::Min:          expected = std::min(x, y);        break;
+                case Operation::AddSaturated: expected = std::min(255, x + y);  break;
+            }
+            ASSERT_EQ( result.storage[index], expected) << "    for op: " << static_cast<int>(op) << " at: " << index;
+        }
+    }
+}
+
+TEST(OperationsTest, CompositeLayers) {
+    const Layout layout(1., 16, 16, 32);
+    Grid map(layout);
+    map.fill(0);
+    map.build_pyramid();
+    Grid obstacles(layout);
+    obstacles.fill(0);
+    obstacles.store({ 5.5, 7.5}, 0x99);
+
+    combine(map, obstacles, Operation::Max);
+    EXPECT_EQ( map.classify({ 5.5, 7.5}), 0x99);
+    // the pyramid follows
+    EXPECT_EQ( map.query_box({ 0, 0}, { 32, 32}), Occupancy::Mixed);
+    EXPECT_EQ( map.query_box({ 10, 10}, { 32, 32}), Occupancy::Free);
+
+    // a layer with a different layout is refused, in either direction, and nothing is written
+    Grid larger({1., 32, 32, 64});
+    larger.fill(0xFF);
+    EXPECT_THROW( combine(map, larger, Operation::Max), std::invalid_argument);
+    EXPECT_EQ( map.classify({ 10.5, 10.5}), 0);
+    EXPECT_THROW( combine(larger, map, Operation::Min), std::invalid_argument);
+    EXPECT_EQ( larger.classify({ 40.5, 40.5}), 0xFF);
+    EXPECT_THROW( combine(map, Grid({1., 20, 16, 32}), Operation::Max), std::invalid_argument);
+}
+
+TEST(OperationsTest, ThresholdAndHistogram) {
+    const Layout layout(1., 50, 50, 100);
+    std::mt19937 generator(51);
+    Grid g(layout);
+    randomize(g, generator);
+
+    const std::vector<cell_value_t> before = g.storage;
+    const auto counts = histogram(g);
+    size_t total = 0;
+    for( size_t value = 0; value < 256; ++value ){
+        total += counts[value];
+        ASSERT_EQ( counts[value], static_cast<size_t>(std::count(before.begin(), before.end(), value)));
+    }
+    EXPECT_EQ( total, g.size());
+
+    threshold(g, 0x80);
+    size_t above = 0;
+    for( size_t index = 0; index < before.size(); ++index ){
+        ASSERT_EQ( g.storage[index], (0x80 <= before[index]) ? 0xFF : 0);
+        above += (0x80 <= before[index]) ? 1 : 0;
+    }
+    EXPECT_EQ( histogram(g)[0xFF], above);
+}
+
+} // namespace terrain::grid
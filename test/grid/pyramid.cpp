@@ -0,0 +1,183 @@
+#include <cmath>
+#include <random>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "grid/pyramid.hpp"
+
+using Eigen::Vector2d;
+
+using terrain::geometry::Layout;
+using terrain::geometry::Occupancy;
+
+namespace terrain::grid {
+
+TEST(PyramidTest, QueryBoxWithoutPyramid) {
+    Grid g({1., 8, 8, 16});
+    g.fill(0);
+    g.store({ 3.5, 4.5}, 0x99);
+
+    EXPECT_FALSE( g.has_pyramid() );
+    EXPECT_EQ( g.query_box({ 0, 0}, { 3, 4}), Occupancy::Free);
+    EXPECT_EQ( g.query_box({ 0, 0}, { 4, 5}), Occupancy::Mixed);
+    EXPECT_EQ( g.query_box({ 3, 4}, { 4, 5}), Occupancy::Blocked);
+    // a degenerate box covers the cell it lies inside
+    EXPECT_EQ( g.query_box({ 3.2, 4.2}, { 3.2, 4.2}), Occupancy::Blocked);
+    // outside of the grid reads as the default value
+    EXPECT_EQ( g.query_box({ 20, 20}, { 30, 30}), Occupancy::Blocked);
+    EXPECT_EQ( g.query_box({ -4, 2}, { 2, 3}), Occupancy::Mixed);
+}
+
+TEST(PyramidTest, MatchesBruteForceScan) {
+    Grid with_pyramid({1., 16, 16, 32});
+    Grid without_pyramid({1., 16, 16, 32});
+    with_pyramid.fill(0);
+    without_pyramid.fill(0);
+    with_pyramid.build_pyramid();
+    ASSERT_TRUE( with_pyramid.has_pyramid() );
+
+    std::mt19937 generator(55);
+    std::uniform_real_distribution<double> coordinate(0., 32.);
+
+    // sparse obstacles, written incrementally through the pyramid
+    for( int obstacle = 0; obstacle < 40; ++obstacle ){
+        const Vector2d at(coordinate(generator), coordinate(generator));
+        with_pyramid.store(at, 0x99);
+        without_pyramid.store(at, 0x99);
+    }
+
+    for( int trial = 0; trial < 500; ++trial ){
+        const double x0 = coordinate(generator);
+        const double y0 = coordinate(generator);
+        const Vector2d min(x0, y0);
+        const Vector2d max(x0 + coordinate(generator)/4, y0 + coordinate(generator)/4);
+
+        ASSERT_EQ( with_pyramid.query_box(min, max), without_pyramid.query_box(min, max))
+            << "    for box: (" << min.x() << ", " << min.y() << ") => (" << max.x() << ", " << max.y() << ")";
+    }
+
+    // clearing a cell must propagate up through the levels again
+    with_pyramid.fill(0x99);
+    EXPECT_EQ( with_pyramid.query_box({0,0}, {32,32}), Occupancy::Blocked);
+    with_pyramid.store({10.5, 20.5}, 0);
+    EXPECT_EQ( with_pyramid.query_box({0,0}, {32,32}), Occupancy::Mixed);
+    EXPECT_EQ( with_pyramid.query_box({10,20}, {11,21}), Occupancy::Free);
+    EXPECT_EQ( with_pyramid.query_box({11,20}, {32,32}), Occupancy::Blocked);
+}
+
+TEST(PyramidTest, UpdateRegionMatchesRebuild) {
+    // every value is blocked, so `summarize` never stops early: it reports each block's exact min and max
+    std::mt19937 generator(46);
+    std::uniform_int_distribution<int> value(1, 0xFF);
+    std::vector<cell_value_t> cells( 32 * 32 );
+    for( auto& cell : cells ){
+        cell = static_cast<cell_value_t>(value(generator));
+    }
+
+    Pyramid updated(32);
+    updated.build(cells);
+
+    // overwrite an unaligned block, lowering some maximums and raising some minimums
+    for( size_t j = 5; j <= 17; ++j ){
+        for( size_t i = 9; i <= 22; ++i ){
+            cells[i + j*32] = static_cast<cell_value_t>((i + j) % 2 ? 1 : 0xFF);
+        }
+    }
+    updated.update_region(cells, 9, 5, 22, 17);
+
+    Pyramid rebuilt(32);
+    rebuilt.build(cells);
+
+    for( size_t level = 0; level <= 5; ++level ){
+        const size_t block = size_t(1) << level;
+        for( size_t j = 0; j < 32; j += block ){
+            for( size_t i = 0; i < 32; i += block ){
+                ASSERT_EQ( updated.summarize(cells, i, j, i + block - 1, j + block - 1),
+                           rebuilt.summarize(cells, i, j, i + block - 1, j + block - 1))
+                    << "    for the level-" << level << " block at: (" << i << ", " << j << ")";
+            }
+        }
+    }
+}
+
+TEST(PyramidTest, StoreBlockMatchesRebuiltPyramid) {
+    const Layout layout(1., 16, 16, 32);
+    Grid with_pyramid(layout);
+    Grid rebuilt(layout);
+    with_pyramid.fill(0);
+    with_pyramid.build_pyramid();
+
+    std::mt19937 generator(47);
+    std::uniform_int_distribution<int> coordinate(0, 31);
+    std::uniform_int_distribution<int> draw(0, 0xFF);
+
+    // random, unaligned blocks: some sparse obstacles, some clearing whole areas again
+    std::vector<cell_value_t> block( 32 * 32 );
+    for( int write = 0; write < 40; ++write ){
+        const size_t i0 = coordinate(generator);
+        const size_t j0 = coordinate(generator);
+        const size_t width = 1 + coordinate(generator) % (32 - i0);
+        const size_t height = 1 + coordinate(generator) % (32 - j0);
+        const bool clearing = (0 == write % 3);
+        for( auto& cell : block ){
+            cell = (clearing || (draw(generator) < 0xE0)) ? 0 : 0x99;
+        }
+        with_pyramid.store_block(i0, j0, width, height, block.data(), 32);
+    }
+
+    // the same cells, summarized from scratch
+    std::vector<cell_value_t> cells( 32 * 32 );
+    with_pyramid.rasterize_into(cells.data(), 32);
+    rebuilt.store_block(0, 0, 32, 32, cells.data(), 32);
+    rebuilt.build_pyramid();
+
+    // every aligned block, at every level of the pyramid
+    for( size_t block_width = 1; block_width <= 32; block_width *= 2 ){
+        for( size_t y = 0; y < 32; y += block_width ){
+            for( size_t x = 0; x < 32; x += block_width ){
+                const Vector2d min(x + 0.25, y + 0.25);
+                const Vector2d max(x + block_width - 0.25, y + block_width - 0.25);
+                ASSERT_EQ( with_pyramid.query_box(min, max), rebuilt.query_box(min, max))
+                    << "    for the " << block_width << "-wide block at: (" << x << ", " << y << ")";
+            }
+        }
+    }
+}
+
+TEST(PyramidTest, AssignAndMoveGrid) {
+    Grid source({1., 8, 8, 16});
+    source.fill(0);
+    source.build_pyramid();
+    source.build_summed_area();
+    source.store({ 3.5, 4.5}, 0x99);
+
+    // an assignment deep-copies the pyramid and the summed-area table, as the copy constructor does
+    Grid assigned({1., 2, 2, 4});
+    assigned = source;
+    ASSERT_TRUE( assigned.has_pyramid() );
+    ASSERT_TRUE( assigned.has_summed_area() );
+    EXPECT_EQ( assigned.get_layout().get_dimension(), 16);
+    source.store({ 3.5, 4.5}, 0);
+    EXPECT_EQ( assigned.query_box({ 0, 0}, {16, 16}), Occupancy::Mixed);
+    EXPECT_EQ( assigned.count_blocked({ 0, 0}, {16, 16}), 1);
+    EXPECT_EQ( source.query_box({ 0, 0}, {16, 16}), Occupancy::Free);
+
+    // a move hands over the pyramid and the table, without copying them
+    Grid moved(std::move(assigned));
+    ASSERT_TRUE( moved.has_pyramid() );
+    ASSERT_TRUE( moved.has_summed_area() );
+    EXPECT_EQ( moved.query_box({ 3, 4}, { 4, 5}), Occupancy::Blocked);
+
+    Grid move_assigned;
+    move_assigned = std::move(moved);
+    ASSERT_TRUE( move_assigned.has_pyramid() );
+    EXPECT_EQ( move_assigned.count_blocked({ 0, 0}, {16, 16}), 1);
+}
+
+} // namespace terrain::grid
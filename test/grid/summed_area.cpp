@@ -0,0 +1,95 @@
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+
+using Eigen::Vector2d;
+
+namespace terrain::grid {
+
+TEST(SummedAreaTest, CountBlockedCells) {
+    Grid g({1., 4, 4, 8});
+    g.fill(0);
+    g.store({ 0.5, 0.5}, 0x99);
+    g.store({ 3.5, 2.5}, 0x99);
+    g.store({ 7.5, 7.5}, 0x99);
+    g.build_summed_area();
+    ASSERT_TRUE( g.has_summed_area() );
+
+    EXPECT_EQ( g.count_blocked({ 0, 0}, { 8, 8}), 3);
+    EXPECT_EQ( g.count_blocked({ 0, 0}, { 4, 3}), 2);
+    EXPECT_EQ( g.count_blocked({ 1, 0}, { 4, 3}), 1);
+    EXPECT_EQ( g.count_blocked({ 4, 4}, { 7, 7}), 0);
+    // only cells within the grid are counted
+    EXPECT_EQ( g.count_blocked({ -4, -4}, { 20, 20}), 3);
+    EXPECT_EQ( g.count_blocked({ 10, 10}, { 20, 20}), 0);
+
+    // writes mark rows dirty; the next count catches up
+    g.store({ 5.5, 5.5}, 0x99);
+    g.store({ 3.5, 2.5}, 0);
+    EXPECT_EQ( g.count_blocked({ 0, 0}, { 8, 8}), 3);
+    EXPECT_EQ( g.count_blocked({ 0, 0}, { 4, 3}), 1);
+
+    g.fill(0x99);
+    EXPECT_EQ( g.count_blocked({ 0, 0}, { 8, 8}), 64);
+}
+
+TEST(SummedAreaTest, MatchesBruteForceScan) {
+    Grid with_table({1., 32, 32, 64});
+    Grid without_table({1., 32, 32, 64});
+    with_table.fill(0);
+    without_table.fill(0);
+    with_table.build_summed_area();
+
+    std::mt19937 generator(55);
+    std::uniform_real_distribution<double> coordinate(0., 64.);
+
+    for( int round = 0; round < 5; ++round ){
+        for( int obstacle = 0; obstacle < 100; ++obstacle ){
+            const Vector2d at(coordinate(generator), coordinate(generator));
+            const cell_value_t value = (obstacle % 3) ? 0x99 : 0;
+            with_table.store(at, value);
+            without_table.store(at, value);
+        }
+
+        for( int trial = 0; trial < 200; ++trial ){
+            const Vector2d min(coordinate(generator), coordinate(generator));
+            const Vector2d max = min + Vector2d(coordinate(generator), coordinate(generator))/2;
+            ASSERT_EQ( with_table.count_blocked(min, max), without_table.count_blocked(min, max));
+        }
+    }
+}
+
+TEST(SummedAreaTest, ConcurrentCountsOnCopy) {
+    Grid g({1., 32, 32, 64});
+    g.fill(0);
+    g.build_summed_area();
+    for( int step = 0; step < 16; ++step ){
+        g.store({ 4. * step + 0.5, 3. * step + 0.5}, 0x99);
+    }
+
+    // the copy is shared with readers as-is (as by `Terrain::publish`), and none of them refreshes its table
+    const Grid copy(g);
+    std::vector<size_t> counts(4, 0);
+    std::vector<std::thread> readers;
+    for( size_t reader = 0; reader < counts.size(); ++reader ){
+        readers.emplace_back([&copy, &counts, reader](){
+            counts[reader] = copy.count_blocked({ 0, 0}, { 64, 64});
+        });
+    }
+    for( auto& reader : readers ){
+        reader.join();
+    }
+
+    for( const size_t count : counts ){
+        EXPECT_EQ( count, 16);
+    }
+}
+
+} // namespace terrain::grid
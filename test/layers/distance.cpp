@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "layers/distance.hpp"
+#include "quadtree/tree.hpp"
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::Layout;
+
+namespace terrain::layers {
+
+TEST(DistanceTest, EmptyGridMeasuresToBorder) {
+    const Layout layout(1., 4, 4, 8);
+    grid::Grid g(layout);
+    g.fill(0);
+
+    const auto distances = distance_transform(g);
+    ASSERT_EQ( distances.get_memory_usage(), 64 * sizeof(float));
+
+    // one cell in from the border is 2 cells from the virtual blocked ring outside it
+    EXPECT_FLOAT_EQ( distances.get_cell(0, 0), 1.f);
+    EXPECT_FLOAT_EQ( distances.get_cell(1, 5), 2.f);
+    EXPECT_FLOAT_EQ( distances.get_cell(3, 4), 4.f);
+    EXPECT_FLOAT_EQ( distances.classify({3.5, 4.5}, -1.f), 4.f);
+    EXPECT_FLOAT_EQ( distances.classify({30, 30}, -1.f), -1.f);
+}
+
+TEST(DistanceTest, MatchesBruteForce) {
+    // precision 2 => 32 x 32 cells
+    const Layout layout(2., 32, 32, 64);
+    const int64_t n = layout.get_dimension();
+    ASSERT_EQ( n, 32);
+
+    // clumps of blocked cells, so that the tree holds leaves of several sizes
+    std::mt19937 generator(37);
+    std::uniform_int_distribution<int64_t> corner(0, n - 4);
+    std::vector<cell_value_t> cells( n * n, 0);
+    for( int clump = 0; clump < 12; ++clump ){
+        const int64_t i0 = corner(generator) & ~1;
+        const int64_t j0 = corner(generator) & ~1;
+        for( int64_t j = j0; j < j0 + 4; ++j ){
+            for( int64_t i = i0; i < i0 + 2; ++i ){
+                cells[i + j*n] = 0x99;
+            }
+        }
+    }
+
+    grid::Grid g(layout);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    std::vector<cell_value_t> north_up( n * n );
+    for( int64_t j = 0; j < n; ++j ){
+        for( int64_t i = 0; i < n; ++i ){
+            g.get_cell(i, j) = cells[i + j*n];
+            north_up[i + (n - 1 - j)*n] = cells[i + j*n];
+        }
+    }
+    tree.store_block(0, 0, n, n, north_up.data(), n);
+    ASSERT_LT( tree.size(), static_cast<size_t>(n*n));
+
+    const auto from_grid = distance_transform(g);
+    const auto from_tree = distance_transform(tree);
+
+    for( int64_t j = 0; j < n; ++j ){
+        for( int64_t i = 0; i < n; ++i ){
+            // the ring of cells just outside the layout counts as blocked
+            int64_t best = std::min({ i + 1, n - i, j + 1, n - j});
+            best *= best;
+            for( int64_t bj = 0; bj < n; ++bj ){
+                for( int64_t bi = 0; bi < n; ++bi ){
+                    if( 0 < cells[bi + bj*n] ){
+                        best = std::min(best, (bi - i)*(bi - i) + (bj - j)*(bj - j));
+                    }
+                }
+            }
+            const float expected = static_cast<float>(std::sqrt(best) * 2.);
+
+            ASSERT_FLOAT_EQ( from_grid.get_cell(i, j), expected) << "    @ (" << i << ", " << j << ")";
+            ASSERT_FLOAT_EQ( from_tree.get_cell(i, j), expected) << "    @ (" << i << ", " << j << ")";
+        }
+    }
+}
+
+} // namespace terrain::layers
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "layers/distance.hpp"
+#include "layers/inflation.hpp"
+#include "quadtree/tree.hpp"
+
+using terrain::geometry::Layout;
+
+namespace terrain::layers {
+
+TEST(InflationTest, CostFallsOffAroundObstacle) {
+    const Layout layout(1., 16, 16, 32);
+    grid::Grid g(layout);
+    g.fill(0);
+    g.get_cell(10, 10) = 0x99;
+
+    const auto costs = inflate(g, 2.0, 1.0);
+    EXPECT_EQ( costs.get_cell(10, 10), cost_lethal);
+    EXPECT_EQ( costs.get_cell(11, 10), cost_inscribed);
+    EXPECT_EQ( costs.get_cell(10,  8), cost_inscribed);
+    // 253 * exp(-(3 - 2))
+    EXPECT_EQ( costs.get_cell(13, 10), 93);
+    // 253 * exp(-(sqrt(8) - 2))
+    EXPECT_EQ( costs.get_cell(12, 12), 110);
+    // far from the obstacle, and from the border
+    EXPECT_EQ( costs.get_cell(22, 22), 0);
+    // the border counts as blocked, too
+    EXPECT_EQ( costs.get_cell(0, 20), cost_inscribed);
+}
+
+TEST(InflationTest, TreeMatchesGridAndFormula) {
+    const Layout layout(1., 32, 32, 64);
+    const size_t n = layout.get_dimension();
+
+    grid::Grid g(layout);
+    g.fill(0);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+
+    // a wall, and an aligned 4x4 block
+    std::vector<cell_value_t> wall(1 * 20, 0x99);
+    std::vector<cell_value_t> block(4 * 4, 0x99);
+    g.store_block(30, 6, 1, 20, wall.data(), 1);
+    g.store_block(40, 40, 4, 4, block.data(), 4);
+    tree.store_block(30, 6, 1, 20, wall.data(), 1);
+    tree.store_block(40, 40, 4, 4, block.data(), 4);
+
+    const double radius = 3.0;
+    const double decay = 0.5;
+    const auto distances = distance_transform(g);
+    const auto from_grid = inflate(g, radius, decay);
+    const auto from_tree = inflate(tree, radius, decay);
+
+    for( size_t j = 0; j < n; ++j ){
+        for( size_t i = 0; i < n; ++i ){
+            const double d = distances.get_cell(i, j);
+            cell_value_t expected = static_cast<cell_value_t>(253 * std::exp(-decay * (d - radius)));
+            if( 0 == d ){
+                expected = cost_lethal;
+            }else if( d <= radius ){
+                expected = cost_inscribed;
+            }
+            ASSERT_EQ( from_grid.get_cell(i, j), expected) << "    @ (" << i << ", " << j << ")";
+            ASSERT_EQ( from_tree.get_cell(i, j), expected) << "    @ (" << i << ", " << j << ")";
+        }
+    }
+}
+
+TEST(InflationTest, SlowFalloffBeyondTable) {
+    // the cost stays above zero for thousands of cells: further than the lookup table reaches
+    const Layout layout(1., 512, 512, 1024);
+    const size_t n = layout.get_dimension();
+    grid::Grid g(layout);
+    g.fill(0);
+    g.get_cell(600, 400) = 0x99;
+
+    const double radius = 2.0;
+    const double decay = 0.001;
+    const auto distances = distance_transform(g);
+    const auto costs = inflate(distances, radius, decay);
+
+    for( size_t j = 0; j < n; j += 7 ){
+        for( size_t i = 0; i < n; i += 5 ){
+            const double d = distances.get_cell(i, j);
+            cell_value_t expected = static_cast<cell_value_t>(253 * std::exp(-decay * (d - radius)));
+            if( 0 == d ){
+                expected = cost_lethal;
+            }else if( d <= radius ){
+                expected = cost_inscribed;
+            }
+            ASSERT_EQ( costs.get_cell(i, j), expected) << "    @ (" << i << ", " << j << ")";
+        }
+    }
+    EXPECT_GT( costs.get_cell(1000, 1000), 0);
+}
+
+TEST(InflationTest, RejectsBadArguments) {
+    const Layout layout(1., 8, 8, 16);
+    grid::Grid g(layout);
+    g.fill(0);
+    g.get_cell(4, 4) = 0x99;
+
+    EXPECT_THROW( inflate(g, 2.0, -1.0), std::invalid_argument);
+    EXPECT_THROW( inflate(g, 2.0,  0.0), std::invalid_argument);
+    EXPECT_THROW( inflate(g, 2.0, std::numeric_limits<double>::quiet_NaN()), std::invalid_argument);
+    EXPECT_THROW( inflate(g, -1.0, 1.0), std::invalid_argument);
+
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    EXPECT_THROW( inflate(tree, 2.0, -0.5), std::invalid_argument);
+
+    // a zero radius is fine: only the obstacle itself is inscribed
+    const auto costs = inflate(g, 0.0, 1.0);
+    EXPECT_EQ( costs.get_cell(4, 4), cost_lethal);
+    EXPECT_LT( costs.get_cell(5, 4), cost_inscribed);
+}
+
+} // namespace terrain::layers
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "grid/grid.hpp"
+#include "planner/planner.hpp"
+#include "quadtree/leaf_graph.hpp"
+#include "quadtree/tree.hpp"
+
+using Eigen::Vector2d;
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::Layout;
+
+namespace terrain::planner {
+
+// a 32x32 map, with a wall across x = 16, open only at its southern end
+static void build_wall( grid::Grid& g, quadtree::Tree& tree, const size_t gap ){
+    const Layout layout(1., 16, 16, 32);
+    g.reset(layout, 0);
+    tree.reset(layout, 0);
+
+    const std::vector<cell_value_t> wall(32 - gap, 0x99);
+    g.store_block(16, gap, 1, 32 - gap, wall.data(), 1);
+    tree.store_block(16, gap, 1, 32 - gap, wall.data(), 1);
+}
+
+// samples along every segment of `path`, and checks that none of the samples lies in a blocked cell
+template<typename terrain_t>
+static void expect_clear( const terrain_t& terrain, const Path& path ){
+    for( size_t index = 1; index < path.waypoints.size(); ++index ){
+        const Vector2d& from = path.waypoints[index - 1];
+        const Vector2d& to = path.waypoints[index];
+        // an odd number of samples per unit of length, offset by half a step, so none lands on a cell corner
+        const size_t samples = 101 * static_cast<size_t>(std::ceil((to - from).norm()) + 1);
+        for( size_t sample = 0; sample < samples; ++sample ){
+            const Vector2d at = from + (to - from) * ((sample + 0.5) / samples);
+            ASSERT_FALSE( is_blocked(terrain.classify(at)) )
+                << "    segment " << index << " crosses a blocked cell at (" << at.x() << ", " << at.y() << ")";
+        }
+    }
+}
+
+TEST(PlannerTest, GridOpenField) {
+    grid::Grid g({1., 16, 16, 32});
+    g.fill(0);
+    Workspace workspace;
+
+    const Path straight = plan(g, {2.5, 3.5}, {12.5, 3.5}, workspace);
+    ASSERT_TRUE( straight.found() );
+    EXPECT_DOUBLE_EQ( straight.length, 10);
+    EXPECT_EQ( straight.waypoints.size(), 11);
+    EXPECT_EQ( straight.waypoints.front(), Vector2d(2.5, 3.5));
+    EXPECT_EQ( straight.waypoints.back(), Vector2d(12.5, 3.5));
+
+    const Path diagonal = plan(g, {2.5, 3.5}, {7.5, 8.5}, workspace);
+    ASSERT_TRUE( diagonal.found() );
+    EXPECT_NEAR( diagonal.length, 5 * M_SQRT2, 1e-9);
+
+    // the same cell
+    const Path here = plan(g, {2.2, 3.3}, {2.7, 3.6}, workspace);
+    ASSERT_TRUE( here.found() );
+    EXPECT_EQ( here.waypoints.size(), 2);
+
+    // outside, or blocked
+    EXPECT_FALSE( plan(g, {2.5, 3.5}, {40, 3.5}, workspace).found() );
+    g.get_cell(12, 3) = 0x99;
+    EXPECT_FALSE( plan(g, {2.5, 3.5}, {12.5, 3.5}, workspace).found() );
+}
+
+TEST(PlannerTest, AroundWall) {
+    grid::Grid g;
+    quadtree::Tree tree;
+    build_wall(g, tree, 4);
+    const quadtree::LeafGraph graph(tree);
+
+    const Vector2d start(4.5, 28.5);
+    const Vector2d goal(28.5, 28.5);
+    Workspace workspace;
+
+    const Path on_grid = plan(g, start, goal, workspace);
+    ASSERT_TRUE( on_grid.found() );
+    // down to the gap, and back up: far longer than the straight line
+    EXPECT_GT( on_grid.length, 2 * 24);
+    for( const Vector2d& waypoint : on_grid.waypoints ){
+        EXPECT_FALSE( is_blocked(g.classify(waypoint)) );
+    }
+    expect_clear(g, on_grid);
+
+    const Path on_tree = plan(tree, graph, start, goal, workspace);
+    ASSERT_TRUE( on_tree.found() );
+    EXPECT_LT( on_tree.waypoints.size(), on_grid.waypoints.size());
+    EXPECT_GE( on_tree.length, on_grid.length - 1e-9);
+    for( const Vector2d& waypoint : on_tree.waypoints ){
+        EXPECT_FALSE( is_blocked(tree.classify(waypoint)) );
+    }
+    expect_clear(tree, on_tree);
+
+    // reusing the workspace gives the same answer
+    EXPECT_DOUBLE_EQ( plan(g, start, goal, workspace).length, on_grid.length);
+
+    // closing the gap
+    build_wall(g, tree, 0);
+    EXPECT_FALSE( plan(g, start, goal, workspace).found() );
+    EXPECT_FALSE( plan(tree, quadtree::LeafGraph(tree), start, goal, workspace).found() );
+}
+
+TEST(PlannerTest, TreePathStaysInsideLeaves) {
+    // a wall across x = 8, open only in the southernmost row; the leaves west of it are large
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    const std::vector<cell_value_t> wall(15, 0x99);
+    tree.store_block(8, 1, 1, 15, wall.data(), 1);
+    tree.prune();
+    const quadtree::LeafGraph graph(tree);
+    Workspace workspace;
+
+    // the start sits in the corner of a large leaf, right beside the wall
+    const Vector2d start(7.9, 7.9);
+    const Vector2d goal(12.5, 0.5);
+    const Path path = plan(tree, graph, start, goal, workspace);
+    ASSERT_TRUE( path.found() );
+    EXPECT_EQ( path.waypoints.front(), start);
+    EXPECT_EQ( path.waypoints.back(), goal);
+    expect_clear(tree, path);
+
+    // and backwards
+    const Path back = plan(tree, graph, goal, start, workspace);
+    ASSERT_TRUE( back.found() );
+    expect_clear(tree, back);
+
+    // inside a single leaf, the path is just the straight line
+    const Path here = plan(tree, graph, {1.5, 1.5}, {6.5, 6.5}, workspace);
+    ASSERT_TRUE( here.found() );
+    EXPECT_EQ( here.waypoints.size(), 2);
+}
+
+TEST(PlannerTest, MultipleGoals) {
+    grid::Grid g;
+    quadtree::Tree tree;
+    build_wall(g, tree, 4);
+    const quadtree::LeafGraph graph(tree);
+
+    const Vector2d start(4.5, 28.5);
+    const std::vector<Vector2d> goals = { {28.5, 28.5}, {4.5, 0.5}, {16.5, 20.5}, {30.5, 2.5}, {60, 60} };
+
+    const auto on_grid = plan(g, start, goals);
+    const auto on_tree = plan(tree, graph, start, goals);
+    ASSERT_EQ( on_grid.size(), goals.size());
+    ASSERT_EQ( on_tree.size(), goals.size());
+
+    Workspace workspace;
+    for( size_t index = 0; index < goals.size(); ++index ){
+        EXPECT_DOUBLE_EQ( on_grid[index].length, plan(g, start, goals[index], workspace).length);
+        EXPECT_DOUBLE_EQ( on_tree[index].length, plan(tree, graph, start, goals[index], workspace).length);
+    }
+    // inside the wall; and outside the map
+    EXPECT_FALSE( on_grid[2].found() );
+    EXPECT_FALSE( on_grid[4].found() );
+    EXPECT_FALSE( on_tree[4].found() );
+}
+
+} // namespace terrain::planner
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Eigen/Geometry>
+
+#include "geometry/cell_value.hpp"
+#include "geometry/layout.hpp"
+#include "quadtree/leaf_graph.hpp"
+#include "quadtree/tree.hpp"
+
+using Eigen::Vector2d;
+
+using terrain::geometry::cell_value_t;
+using terrain::geometry::Layout;
+
+namespace terrain::quadtree {
+
+TEST(LeafGraphTest, Quadrants) {
+    Tree tree;
+    tree.reset({1., 8, 8, 16}, 0);
+    const std::vector<cell_value_t> blocked(8 * 8, 0x99);
+    tree.store_block(8, 8, 8, 8, blocked.data(), 8);
+    ASSERT_EQ( tree.size(), 5);
+
+    const LeafGraph graph(tree);
+    ASSERT_EQ( graph.size(), 3);
+    ASSERT_EQ( graph.edge_count(), 4);
+
+    // Morton order: SW, SE, NW
+    const size_t southwest = graph.find(tree.locate({2, 2}));
+    const size_t southeast = graph.find(tree.locate({12, 2}));
+    const size_t northwest = graph.find(tree.locate({2, 12}));
+    EXPECT_EQ( southwest, 0);
+    EXPECT_EQ( southeast, 1);
+    EXPECT_EQ( northwest, 2);
+    EXPECT_EQ( graph.find(tree.locate({12, 12})), LeafGraph::npos);
+
+    EXPECT_DOUBLE_EQ( graph.centers[southwest].x(), 4);
+    EXPECT_DOUBLE_EQ( graph.centers[southwest].y(), 4);
+    EXPECT_DOUBLE_EQ( graph.widths[southwest], 8);
+
+    // the south-west leaf touches both others; they only touch it
+    EXPECT_EQ( graph.offsets[southwest + 1] - graph.offsets[southwest], 2);
+    EXPECT_EQ( graph.offsets[southeast + 1] - graph.offsets[southeast], 1);
+    EXPECT_EQ( graph.targets[graph.offsets[southeast]], southwest);
+    EXPECT_DOUBLE_EQ( graph.border_lengths[graph.offsets[southeast]], 8);
+}
+
+TEST(LeafGraphTest, MatchesNeighbors) {
+    Tree tree;
+    tree.reset({1., 16, 16, 32}, 0);
+    const std::vector<cell_value_t> blocked(3 * 5, 0x99);
+    tree.store_block( 3,  4, 3, 5, blocked.data(), 3);
+    tree.store_block(17, 20, 1, 1, blocked.data(), 1);
+    tree.store_block(24,  2, 1, 3, blocked.data(), 1);
+
+    const LeafGraph graph(tree);
+    std::vector<Leaf> free;
+    tree.leaves([](const cell_value_t value){ return ! is_blocked(value); }, free);
+    ASSERT_EQ( graph.size(), free.size());
+    ASSERT_EQ( graph.offsets.size(), free.size() + 1);
+    ASSERT_EQ( graph.offsets.back(), graph.edge_count());
+
+    std::vector<Leaf> found;
+    for( size_t node = 0; node < graph.size(); ++node ){
+        ASSERT_TRUE( graph.leaves[node] == free[node] );
+        const Sample s = tree.sample_leaf(free[node]);
+        EXPECT_EQ( s.at, graph.centers[node]);
+
+        // every free neighbor appears once, with a matching edge back again
+        size_t expected_edges = 0;
+        for( const Direction direction : {Direction::North, Direction::East, Direction::South, Direction::West} ){
+            tree.neighbors(free[node], direction, found);
+            for( const Leaf& neighbor : found ){
+                if( ! is_blocked(tree.sample_leaf(neighbor).is) ){
+                    ++expected_edges;
+                }
+            }
+        }
+        ASSERT_EQ( graph.offsets[node + 1] - graph.offsets[node], expected_edges);
+
+        for( size_t edge = graph.offsets[node]; edge < graph.offsets[node + 1]; ++edge ){
+            const size_t target = graph.targets[edge];
+            EXPECT_DOUBLE_EQ( graph.border_lengths[edge], std::min(graph.widths[node], graph.widths[target]));
+
+            size_t back = 0;
+            for( size_t reverse = graph.offsets[target]; reverse < graph.offsets[target + 1]; ++reverse ){
+                back += (node == graph.targets[reverse]) ? 1 : 0;
+            }
+            EXPECT_EQ( back, 1);
+        }
+    }
+}
+
+} // namespace terrain::quadtree
@@ -12,10 +12,10 @@ TEST(NodeTest, ConstructDefault) {
     Node n;
     
     ASSERT_TRUE( n.is_leaf() );
-    ASSERT_EQ( n.northeast.get(), nullptr);
-    ASSERT_EQ( n.northwest.get(), nullptr);
-    ASSERT_EQ( n.southwest.get(), nullptr);
-    ASSERT_EQ( n.southeast.get(), nullptr);
+    ASSERT_EQ( n.get_northeast(), nullptr);
+    ASSERT_EQ( n.get_northwest(), nullptr);
+    ASSERT_EQ( n.get_southwest(), nullptr);
+    ASSERT_EQ( n.get_southeast(), nullptr);
 
     ASSERT_EQ( n.get_value(), 0);
 }
@@ -24,10 +24,10 @@ TEST(NodeTest, ConstructWithValue) {
     Node n(0);
     
     ASSERT_TRUE( n.is_leaf() );
-    ASSERT_EQ( n.northeast.get(), nullptr);
-    ASSERT_EQ( n.northwest.get(), nullptr);
-    ASSERT_EQ( n.southwest.get(), nullptr);
-    ASSERT_EQ( n.southeast.get(), nullptr);
+    ASSERT_EQ( n.get_northeast(), nullptr);
+    ASSERT_EQ( n.get_northwest(), nullptr);
+    ASSERT_EQ( n.get_southwest(), nullptr);
+    ASSERT_EQ( n.get_southeast(), nullptr);
 
     ASSERT_EQ( n.get_value(), 0);
 }
@@ -38,10 +38,10 @@ TEST(NodeTest, SetGet) {
     ASSERT_EQ(n.get_value(), 22);
 
     ASSERT_TRUE( n.is_leaf() );
-    ASSERT_EQ( n.northeast.get(), nullptr);
-    ASSERT_EQ( n.northwest.get(), nullptr);
-    ASSERT_EQ( n.southwest.get(), nullptr);
-    ASSERT_EQ( n.southeast.get(), nullptr);
+    ASSERT_EQ( n.get_northeast(), nullptr);
+    ASSERT_EQ( n.get_northwest(), nullptr);
+    ASSERT_EQ( n.get_southwest(), nullptr);
+    ASSERT_EQ( n.get_southeast(), nullptr);
     
     n.set_value(24);
 
@@ -83,4 +83,62 @@ TEST(NodeTest, SplitNodeConditional){
     ASSERT_TRUE( n.get_southwest()->is_leaf() );
 }
 
+TEST(NodeTest, SummarizeChildren){
+    Node n(0);
+    n.split(1, 4);
+    ASSERT_EQ( n.get_minimum(), 0);
+    ASSERT_EQ( n.get_maximum(), 0);
+
+    n.get_northeast()->get_southwest()->set_value(7);
+    n.get_southwest()->set_value(3);
+    // summaries are refreshed bottom-up, by the caller:
+    n.get_northeast()->update_summary();
+    ASSERT_TRUE( n.update_summary() );
+    EXPECT_EQ( n.get_minimum(), 0);
+    EXPECT_EQ( n.get_maximum(), 7);
+    ASSERT_FALSE( n.update_summary() );
+
+    n.fill(5);
+    EXPECT_TRUE( n.is_leaf() );
+    EXPECT_EQ( n.get_minimum(), 5);
+    EXPECT_EQ( n.get_maximum(), 5);
+
+    n.split(1, 4);
+    n.get_northwest()->get_northwest()->set_value(9);
+    n.prune();
+    EXPECT_FALSE( n.is_leaf() );
+    EXPECT_TRUE( n.get_northeast()->is_leaf() );
+    EXPECT_EQ( n.get_minimum(), 5);
+    EXPECT_EQ( n.get_maximum(), 9);
+}
+
+TEST(NodeTest, CopyOnWrite){
+    Node original(0);
+    original.split(1, 4);
+
+    // a copy shares the children ...
+    Node copy(original);
+    ASSERT_FALSE( copy.is_leaf() );
+    EXPECT_EQ( copy.get_northeast(), original.get_northeast());
+
+    // ... until it is written beneath: then only the written path is copied
+    copy.split();
+    copy.get_northeast()->split();
+    copy.get_northeast()->get_southwest()->set_value(7);
+    copy.get_northeast()->update_summary();
+    copy.update_summary();
+
+    EXPECT_NE( copy.get_northeast(), original.get_northeast());
+    EXPECT_NE( copy.get_northeast()->get_southwest(), original.get_northeast()->get_southwest());
+    EXPECT_EQ( copy.get_northwest()->get_southwest(), original.get_northwest()->get_southwest());
+    EXPECT_EQ( copy.get_maximum(), 7);
+    EXPECT_EQ( original.get_maximum(), 0);
+    EXPECT_EQ( original.get_northeast()->get_southwest()->get_value(), 0);
+
+    // once written, the path belongs to the copy, and is written in place
+    Node* written = copy.get_northeast();
+    copy.split();
+    EXPECT_EQ( copy.get_northeast(), written);
+}
+
 } // namespace quadtree
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <Eigen/Geometry>
@@ -11,8 +18,11 @@
 
 #include <nlohmann/json/json.hpp>
 
+#include "geometry/interpolate.hpp"
 #include "geometry/layout.hpp"
 #include "geometry/polygon.hpp"
+#include "grid/grid.hpp"
+#include "grid/operations.hpp"
 #include "quadtree/tree.hpp"
 #include "terrain.hpp"
 #include "io/readers.hpp"
@@ -48,11 +58,13 @@ TEST( QuadTreeTest, CalculateMemoryUsage){
     
     assert_layouts_match( terrain.get_layout(), default_layout);
 
-    EXPECT_EQ(sizeof(Terrain<Tree>), 32);
+    // composed of: implementation reference, error message, two snapshot slots (and their reader counts), publish mutex
+    EXPECT_EQ(sizeof(Terrain<Tree>), sizeof(Tree*) + sizeof(std::string) + 2*sizeof(std::shared_ptr<const Tree>)
+                                      + 3*sizeof(std::atomic<size_t>) + sizeof(std::mutex));
     EXPECT_EQ(sizeof(Layout), 64);
     EXPECT_EQ(sizeof(Tree), 72);     // composed of: Layout, root-pointer
     EXPECT_EQ(sizeof(Vector2d), 16);
-    EXPECT_EQ(sizeof(Node), 40);
+    EXPECT_EQ(sizeof(Node), 16);     // composed of: child-block pointer, value, min, max
 }
 
 TEST(QuadTreeTest, ConstructDefault) {
@@ -433,64 +445,927 @@ TEST( QuadTreeTest, SampleTree ){
     const Sample s4 = tree.sample({  1.7,  3.3});
     ASSERT_TRUE( Vector2d(1.5, 3.5) == s4.at );
     ASSERT_EQ( s4.is,   2);
+    ASSERT_DOUBLE_EQ( s4.width, 1.);
+
+    // a pruned tree answers from the larger, merged leaf
+    tree.fill(0);
+    tree.store({0.5, 0.5}, 9);
+    tree.prune();
+    const Sample s5 = tree.sample({  3.2,  3.6});
+    ASSERT_TRUE( Vector2d(3, 3) == s5.at );
+    ASSERT_EQ( s5.is,   0);
+    ASSERT_DOUBLE_EQ( s5.width, 2.);
+
+    const Sample s6 = tree.sample({  0.2,  0.6});
+    ASSERT_TRUE( Vector2d(0.5, 0.5) == s6.at );
+    ASSERT_EQ( s6.is,   9);
+    ASSERT_DOUBLE_EQ( s6.width, 1.);
 }
 
-// TEST( QuadTreeTest, InterpolateTree){
-//     Tree tree({{1,1}, 64}, 1.0);
-//     Terrain terrain(tree);
-//     tree.root->split();
-
-//     // Set Quadrant I:
-//     tree.root->get_northeast()->set_value(0);
-//     // Set Quadrdant II:
-//     tree.root->get_northwest()->set_value(50);
-//     // Set Quadrant III:
-//     tree.root->get_southwest()->set_value(100);
-//     // Set Quadrant IV:
-//     tree.root->get_southeast()->set_value(50);
-
-
-//     vector<TestPoint> test_cases;
-//     test_cases.emplace_back( -35,    4, cell_default_value);  // Start out of bounds
-//     test_cases.emplace_back( -33,    4, cell_default_value);
-//     test_cases.emplace_back( -32,    4, cell_default_value);
-//     test_cases.emplace_back( -31,    4,   70);  // border of tree
-//     test_cases.emplace_back( -30.9,  4,   70);
-//     test_cases.emplace_back( -30,    4,   70);
-//     test_cases.emplace_back( -20,    4,   70);
-//     test_cases.emplace_back( -17,    4,   70);
-//     test_cases.emplace_back( -16,    4,   70);
-//     test_cases.emplace_back( -15.1,  4,   70);
-//     test_cases.emplace_back( -15.0,  4,   70);  // breakpoint - center of outer cell
-//     test_cases.emplace_back( -14.9,  4,   70);
-//     test_cases.emplace_back( -10,    4,   62);
-//     test_cases.emplace_back( - 5,    4,   54);
-//     test_cases.emplace_back(   0,    4,   47);
-//     test_cases.emplace_back(   1,    4,   45);  // midpoint
-//     test_cases.emplace_back(   2,    4,   43);
-//     test_cases.emplace_back(  10,    4,   31);
-//     test_cases.emplace_back(  14,    4,   25);
-//     test_cases.emplace_back(  15,    4,   23);
-//     test_cases.emplace_back(  16,    4,   22);  // breakpoint - center of outer cell
-//     test_cases.emplace_back(  17,    4,   20);
-//     test_cases.emplace_back(  20,    4,   20);
-//     test_cases.emplace_back(  30,    4,   20);
-//     test_cases.emplace_back(  31,    4,   20);
-//     test_cases.emplace_back(  32,    4,   20);
-//     test_cases.emplace_back(  33,    4,   20);  // border of tree
-//     test_cases.emplace_back(  34,    4, cell_default_value);
-//     test_cases.emplace_back(  35,    4, cell_default_value);
-
-//     // =====================================
-//     for( const TestPoint& expect : test_cases){
-//         const auto& actual_value = tree.interp({expect.x, expect.y});
-
-//         std::ostringstream buf;
-//         buf << "@@  x=" << expect.x << "  y=" << expect.y << "  v=" << expect.value << endl;
-
-//         ASSERT_EQ(actual_value, expect.value) << buf.str();
-//     }
-// }
+TEST( QuadTreeTest, ScanRow ){
+    const string source(R"(
+        {"layout": {"precision": 1, "x": 4, "y": 4, "width": 8},
+         "grid":[[ 88, 88, 88, 88, 88, 88, 88, 88],
+                 [ 88, 88, 88,  0,  0, 88, 88, 88],
+                 [ 88, 88,  0,  0,  0,  0, 88, 88],
+                 [ 88,  0,  0,  0,  0,  0,  0, 88],
+                 [ 88, 88, 88, 88,  0,  0,  0, 88],
+                 [ 88, 88, 88, 88,  0,  0, 88, 88],
+                 [ 88, 88, 88, 88,  0, 88, 88, 88],
+                 [ 88, 88, 88, 88, 88, 88, 88, 88]]} )");
+
+    quadtree::Tree tree;
+    Terrain tree_terrain(tree);
+    std::istringstream tree_stream(source);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(tree_terrain, tree_stream));
+    tree.prune();
+
+    grid::Grid grid;
+    Terrain grid_terrain(grid);
+    std::istringstream grid_stream(source);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(grid_terrain, grid_stream));
+
+    std::vector<geometry::Run> runs;
+    tree.scan_row(4.5, runs);
+    ASSERT_EQ( runs.size(), 3);
+    EXPECT_DOUBLE_EQ( runs[0].x_begin, 0.);
+    EXPECT_DOUBLE_EQ( runs[0].x_end,   1.);
+    EXPECT_EQ( runs[0].is, 88);
+    EXPECT_DOUBLE_EQ( runs[1].x_begin, 1.);
+    EXPECT_DOUBLE_EQ( runs[1].x_end,   7.);
+    EXPECT_EQ( runs[1].is,  0);
+    EXPECT_DOUBLE_EQ( runs[2].x_begin, 7.);
+    EXPECT_DOUBLE_EQ( runs[2].x_end,   8.);
+    EXPECT_EQ( runs[2].is, 88);
+
+    // both backends agree, row by row
+    std::vector<geometry::Run> expected;
+    for( double y = 0.5; y < 8; y += 1 ){
+        tree.scan_row(y, runs);
+        grid.scan_row(y, expected);
+        ASSERT_EQ( runs.size(), expected.size()) << "    @ y=" << y;
+        for( size_t index = 0; index < runs.size(); ++index ){
+            EXPECT_DOUBLE_EQ( runs[index].x_begin, expected[index].x_begin);
+            EXPECT_DOUBLE_EQ( runs[index].x_end,   expected[index].x_end);
+            EXPECT_EQ( runs[index].is, expected[index].is);
+        }
+    }
+
+    // outside of the layout, there is nothing to scan
+    tree.scan_row(-1, runs);
+    EXPECT_TRUE( runs.empty() );
+    grid.scan_row(9, runs);
+    EXPECT_TRUE( runs.empty() );
+}
+
+TEST( QuadTreeTest, QueryBox ){
+    // blocked border, with a free interior and a few blocked islands (in cell-exact json grid form)
+    json source = {{"layout", {{"precision", 1.}, {"x", 16.}, {"y", 16.}, {"width", 32.}}}};
+    for( int row = 0; row < 32; ++row ){
+        for( int column = 0; column < 32; ++column ){
+            const bool border = (row < 4) || (28 <= row) || (column < 4) || (28 <= column);
+            const bool island = (8 <= row) && (row < 11) && ((column % 8) < 2);
+            source["grid"][row][column] = (border || island) ? 0x99 : 0;
+        }
+    }
+    std::istringstream tree_stream(source.dump());
+    std::istringstream grid_stream(source.dump());
+
+    Tree tree;
+    Terrain tree_terrain(tree);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(tree_terrain, tree_stream));
+    grid::Grid grid;
+    Terrain grid_terrain(grid);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(grid_terrain, grid_stream));
+
+    EXPECT_EQ( tree.query_box({ 14, 14}, { 18, 18}), Occupancy::Free);
+    EXPECT_EQ( tree.query_box({  0,  0}, {  4,  4}), Occupancy::Blocked);
+    EXPECT_EQ( tree.query_box({  0,  0}, { 32, 32}), Occupancy::Mixed);
+    EXPECT_EQ( tree.query_box({ 40, 40}, { 50, 50}), Occupancy::Blocked);
+
+    // the backends must agree, box-for-box
+    for( double x = -2.5; x < 34; x += 1.75 ){
+        for( double y = -2.5; y < 34; y += 2.25 ){
+            for( double size : {0., 0.5, 1., 3., 7.5} ){
+                const Vector2d min(x, y);
+                const Vector2d max(x + size, y + size);
+                ASSERT_EQ( tree.query_box(min, max), grid.query_box(min, max))
+                    << "    for box: (" << x << ", " << y << ") + " << size;
+            }
+        }
+    }
+
+    // summaries must follow a store
+    tree.store({ 16.5, 16.5}, 0x99);
+    EXPECT_EQ( tree.query_box({ 14, 14}, { 18, 18}), Occupancy::Mixed);
+    EXPECT_EQ( tree.query_box({ 16, 16}, { 17, 17}), Occupancy::Blocked);
+    tree.store({ 16.5, 16.5}, 0);
+    EXPECT_EQ( tree.query_box({ 14, 14}, { 18, 18}), Occupancy::Free);
+
+    tree.fill(0);
+    EXPECT_EQ( tree.query_box({  0,  0}, { 32, 32}), Occupancy::Free);
+}
+
+TEST( QuadTreeTest, FirstHit ){
+    // a free interior, with a blocked border and a blocked block in the north-east
+    json source = {{"layout", {{"precision", 1.}, {"x", 8.}, {"y", 8.}, {"width", 16.}}}};
+    for( int row = 0; row < 16; ++row ){
+        for( int column = 0; column < 16; ++column ){
+            const bool border = (0 == row) || (15 == row) || (0 == column) || (15 == column);
+            const bool block = (2 <= row) && (row < 6) && (10 <= column) && (column < 14);
+            source["grid"][row][column] = (border || block) ? 0x99 : 0;
+        }
+    }
+    std::istringstream tree_stream(source.dump());
+    std::istringstream grid_stream(source.dump());
+
+    Tree tree;
+    Terrain tree_terrain(tree);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(tree_terrain, tree_stream));
+    grid::Grid grid;
+    Terrain grid_terrain(grid);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(grid_terrain, grid_stream));
+
+    {   // horizontal ray, into the block
+        const auto hit = tree.first_hit({ 2.5, 12.5}, { 14.5, 12.5}, is_blocked);
+        ASSERT_TRUE( hit );
+        EXPECT_DOUBLE_EQ( hit->at[0], 10.);
+        EXPECT_DOUBLE_EQ( hit->at[1], 12.5);
+        EXPECT_EQ( hit->is, 0x99);
+    }{  // segment ending short of the block
+        EXPECT_FALSE( tree.first_hit({ 2.5, 12.5}, { 9.5, 12.5}, is_blocked));
+    }{  // starting on a hit
+        const auto hit = tree.first_hit({ 0.5, 0.5}, { 8, 8}, is_blocked);
+        ASSERT_TRUE( hit );
+        EXPECT_DOUBLE_EQ( hit->at[0], 0.5);
+    }{  // ray arriving from outside the tree
+        const auto hit = tree.first_hit({ -8, 4.5}, { 8, 4.5}, is_blocked);
+        ASSERT_TRUE( hit );
+        EXPECT_DOUBLE_EQ( hit->at[0], 0.);
+    }
+
+    // both backends must report the same hits
+    for( double angle = 0; angle < 2*M_PI; angle += 0.05 ){
+        for( double length : {3., 6., 20.} ){
+            const Vector2d from(6.3, 7.1);
+            const Vector2d to = from + length * Vector2d(std::cos(angle), std::sin(angle));
+            const auto tree_hit = tree.first_hit(from, to, is_blocked);
+            const auto grid_hit = grid.first_hit(from, to, is_blocked);
+
+            ASSERT_EQ( static_cast<bool>(tree_hit), static_cast<bool>(grid_hit)) << "    @ angle: " << angle << " length: " << length;
+            if( tree_hit ){
+                EXPECT_NEAR( tree_hit->at[0], grid_hit->at[0], 1e-9);
+                EXPECT_NEAR( tree_hit->at[1], grid_hit->at[1], 1e-9);
+                EXPECT_EQ( tree_hit->is, grid_hit->is);
+            }
+        }
+    }
+}
+
+TEST( QuadTreeTest, InterpolateTree){
+    quadtree::Tree tree;
+    tree.reset({1., 0, 0, 64}, 0);
+    const std::vector<cell_value_t> northwest(32 * 32, 50);
+    const std::vector<cell_value_t> southwest(32 * 32, 100);
+    const std::vector<cell_value_t> southeast(32 * 32, 50);
+    tree.store_block( 0, 32, 32, 32, northwest.data(), 32);
+    tree.store_block( 0,  0, 32, 32, southwest.data(), 32);
+    tree.store_block(32,  0, 32, 32, southeast.data(), 32);
+    ASSERT_EQ( tree.size(), 5);
+
+    EXPECT_EQ( tree.interp({-40,   4}), cell_default_value);
+    EXPECT_EQ( tree.interp({ 33,  40}), cell_default_value);
+
+    // leaf centers
+    EXPECT_EQ( tree.interp({-16, -16}), 100);
+    EXPECT_EQ( tree.interp({ 16,  16}), 0);
+    // between the centers: 3/4 of the way from 50 to 100
+    EXPECT_EQ( tree.interp({-16,   8}), 63);
+    EXPECT_EQ( tree.interp({ -8, -16}), 88);
+    EXPECT_EQ( tree.interp({  0,   0}), 50);
+    // beyond the outermost centers, the values hold steady
+    EXPECT_EQ( tree.interp({-31, -20}), 100);
+    EXPECT_EQ( tree.interp({-30,   4}), 69);
+
+    // leaves of several sizes: compare against four independent lookups
+    const std::vector<cell_value_t> block = { 200, 10, 30, 250};
+    tree.store_block(20, 30, 2, 2, block.data(), 2);
+    tree.store_block(45, 51, 1, 1, block.data(), 1);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> coordinate(-32, 32);
+    std::vector<Vector2d> points;
+    for( int trial = 0; trial < 2000; ++trial ){
+        const Vector2d at(coordinate(generator), coordinate(generator));
+        points.push_back(at);
+
+        const Sample near = tree.sample(at);
+        const double dx = std::copysign(near.width, at.x() - near.at.x());
+        const double dy = std::copysign(near.width, at.y() - near.at.y());
+        auto probe = [&](const double x, const double y) -> Sample {
+            const Vector2d clamped( tree.get_layout().constrain_x(x), tree.get_layout().constrain_y(y));
+            return {{x, y}, tree.classify(clamped)};
+        };
+        const Sample shifted_x = probe(near.at.x() + dx, near.at.y());
+        const Sample shifted_y = probe(near.at.x(), near.at.y() + dy);
+        const Sample shifted_xy = probe(near.at.x() + dx, near.at.y() + dy);
+        const Sample here = probe(near.at.x(), near.at.y());
+
+        const Sample& ne = (0 < dx) ? ((0 < dy) ? shifted_xy : shifted_x) : ((0 < dy) ? shifted_y : here);
+        const Sample& nw = (0 < dx) ? ((0 < dy) ? shifted_y : here) : ((0 < dy) ? shifted_xy : shifted_x);
+        const Sample& sw = (0 < dx) ? ((0 < dy) ? here : shifted_y) : ((0 < dy) ? shifted_x : shifted_xy);
+        const Sample& se = (0 < dx) ? ((0 < dy) ? shifted_x : shifted_xy) : ((0 < dy) ? here : shifted_y);
+
+        ASSERT_EQ( tree.interp(at), interpolate_bilinear(at, ne, nw, sw, se)) << "    @ " << at.x() << ", " << at.y();
+    }
+
+    // the batch reads outside points as the default value, too
+    points.emplace_back(-40, 4);
+    points.emplace_back(33, 40);
+
+    std::vector<cell_value_t> values;
+    tree.interp(points, values);
+    ASSERT_EQ( values.size(), points.size());
+    EXPECT_EQ( values.back(), cell_default_value);
+    for( size_t index = 0; index < points.size(); ++index ){
+        ASSERT_EQ( values[index], tree.interp(points[index]));
+    }
+}
+
+TEST( QuadTreeTest, RasterizeInto ){
+    const string source(R"(
+        {"layout": {"precision": 1, "x": 4, "y": 4, "width": 8},
+         "grid":[[ 88, 88, 88, 88, 88, 88, 88, 88],
+                 [ 88, 88, 88,  0,  0, 88, 88, 88],
+                 [ 88, 88,  0,  0,  0,  0, 88, 88],
+                 [ 88,  0,  0,  0,  0,  0,  0, 88],
+                 [ 88, 88, 88, 88,  0,  0,  0, 88],
+                 [ 88, 88, 88, 88,  0,  0, 88, 88],
+                 [ 88, 88, 88, 88,  0, 88, 88, 88],
+                 [ 88, 88, 88, 99, 88, 88, 88, 88]]} )");
+    const json doc = json::parse(source);
+
+    quadtree::Tree tree;
+    Terrain tree_terrain(tree);
+    std::istringstream tree_stream(source);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(tree_terrain, tree_stream));
+    tree.prune();
+
+    grid::Grid grid;
+    Terrain grid_terrain(grid);
+    std::istringstream grid_stream(source);
+    ASSERT_TRUE( terrain::io::load_from_json_stream(grid_terrain, grid_stream));
+
+    // padded rows: the bytes past each row must be left alone
+    const size_t stride = 11;
+    std::vector<cell_value_t> from_tree( 8 * stride, 0x42);
+    std::vector<cell_value_t> from_grid( 8 * stride, 0x42);
+    tree_terrain.rasterize_into(from_tree.data(), stride);
+    grid_terrain.rasterize_into(from_grid.data(), stride);
+
+    for( size_t row = 0; row < 8; ++row ){
+        for( size_t column = 0; column < 8; ++column ){
+            const cell_value_t expected = doc["grid"][row][column].get<cell_value_t>();
+            ASSERT_EQ( from_tree[row*stride + column], expected) << "    @ row: " << row << "  column: " << column;
+            ASSERT_EQ( from_grid[row*stride + column], expected) << "    @ row: " << row << "  column: " << column;
+        }
+        for( size_t column = 8; column < stride; ++column ){
+            ASSERT_EQ( from_tree[row*stride + column], 0x42);
+            ASSERT_EQ( from_grid[row*stride + column], 0x42);
+        }
+    }
+}
+
+TEST( QuadTreeTest, StoreBlock ){
+    const Layout layout(1., 16, 16, 32);
+    quadtree::Tree tree;
+    tree.reset(layout, 0x99);
+    ASSERT_EQ( tree.size(), 1);
+
+    grid::Grid grid;
+    grid.build_pyramid();
+    grid.reset(layout, 0x99);
+
+    // a free 16x16 square, with a blocked 2x2 island, written at an aligned corner
+    std::vector<cell_value_t> block( 16 * 16, 0);
+    block[3*16 + 5] = 0x99;
+    block[3*16 + 6] = 0x99;
+    block[4*16 + 5] = 0x99;
+    block[4*16 + 6] = 0x99;
+    tree.store_block(16, 0, 16, 16, block.data(), 16);
+    grid.store_block(16, 0, 16, 16, block.data(), 16);
+
+    // ... and an unaligned 3x2 strip of a distinct value
+    const std::vector<cell_value_t> strip = { 7, 7, 7, 0,
+                                              7, 7, 7, 0};
+    tree.store_block(3, 20, 3, 2, strip.data(), 4);
+    grid.store_block(3, 20, 3, 2, strip.data(), 4);
+
+    std::vector<cell_value_t> from_tree( 32 * 32 );
+    std::vector<cell_value_t> from_grid( 32 * 32 );
+    tree.rasterize_into(from_tree.data(), 32);
+    grid.rasterize_into(from_grid.data(), 32);
+    ASSERT_EQ( from_tree, from_grid);
+
+    // block row 3 is the 4th row from the block's northern edge: cell row 15 - 3 = 12
+    EXPECT_EQ( tree.classify({21.5, 12.5}), 0x99);
+    EXPECT_EQ( tree.classify({21.5, 10.5}), 0);
+    EXPECT_EQ( tree.classify({ 3.5, 20.5}), 7);
+    EXPECT_EQ( tree.classify({ 6.5, 20.5}), 0x99);
+
+    // equal leaves are merged as the block is written: only the edges of each write stay split
+    EXPECT_LT( tree.size(), 200);
+
+    // summaries were maintained on the way up
+    EXPECT_EQ( tree.query_box({16, 0}, {32, 16}), Occupancy::Mixed);
+    EXPECT_EQ( tree.query_box({24, 0}, {32, 8}), Occupancy::Free);
+    EXPECT_EQ( grid.query_box({24, 0}, {32, 8}), Occupancy::Free);
+    EXPECT_EQ( grid.query_box({21, 11}, {23, 13}), Occupancy::Blocked);
+}
+
+TEST( QuadTreeTest, StoreBatch ){
+    const Layout layout(1., 16, 16, 32);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    grid::Grid grid(layout);
+    grid.fill(0);
+    grid::Grid reference(layout);
+    reference.fill(0);
+
+    std::mt19937 generator(34);
+    std::uniform_real_distribution<double> coordinate(-2., 34.);
+    std::uniform_int_distribution<int> value(1, 4);
+
+    std::vector<Vector2d> points;
+    std::vector<cell_value_t> values;
+    for( int index = 0; index < 300; ++index ){
+        points.emplace_back(coordinate(generator), coordinate(generator));
+        values.push_back(value(generator));
+    }
+    // repeated writes to one cell: the last one wins
+    points.emplace_back(7.2, 9.8);
+    values.push_back(5);
+    points.emplace_back(7.7, 9.1);
+    values.push_back(6);
+
+    tree.store_batch(points, values);
+    grid.store_batch(points, values);
+    for( size_t index = 0; index < points.size(); ++index ){
+        reference.store(points[index], values[index]);
+    }
+
+    std::vector<cell_value_t> from_tree( 32 * 32 );
+    std::vector<cell_value_t> from_grid( 32 * 32 );
+    std::vector<cell_value_t> expected( 32 * 32 );
+    tree.rasterize_into(from_tree.data(), 32);
+    grid.rasterize_into(from_grid.data(), 32);
+    reference.rasterize_into(expected.data(), 32);
+    ASSERT_EQ( from_grid, expected);
+    ASSERT_EQ( from_tree, expected);
+    EXPECT_EQ( tree.classify({7.5, 9.5}), 6);
+
+    // untouched regions stay as merged leaves
+    EXPECT_LT( tree.size(), 1365);
+    EXPECT_EQ( tree.query_box({0,0}, {32,32}), Occupancy::Mixed);
+
+    // a point exactly on a cell border lands where `classify` looks for it
+    tree.store_batch({{8., 8.}}, {9});
+    EXPECT_EQ( tree.classify({8., 8.}), 9);
+    EXPECT_EQ( tree.classify({7.5, 7.5}), 9);
+}
+
+TEST( QuadTreeTest, StoreBatchOnBorders ){
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    grid::Grid grid(layout);
+    grid.fill(0);
+
+    // a cell corner, a cell edge, the north and east borders, and the north-east corner of the layout
+    const std::vector<Vector2d> points = {{8., 8.}, {3., 5.5}, {10.5, 16.}, {16., 2.5}, {16., 16.}, {0., 0.}};
+    const std::vector<cell_value_t> values = {1, 2, 3, 4, 5, 6};
+    tree.store_batch(points, values);
+    grid.store_batch(points, values);
+
+    // each point went where its own backend classifies it
+    for( size_t index = 0; index < points.size(); ++index ){
+        EXPECT_EQ( tree.classify(points[index]), values[index]) << "    for point: " << index;
+    }
+
+    // the border points wrapped nowhere: every other cell is untouched
+    std::vector<cell_value_t> from_grid( 16 * 16 );
+    grid.rasterize_into(from_grid.data(), 16);
+    EXPECT_EQ( std::count(from_grid.begin(), from_grid.end(), 0), 256 - 6);
+
+    // and the terrain wrapper agrees
+    grid::Grid wrapped_grid(layout);
+    wrapped_grid.fill(0);
+    Terrain terrain(wrapped_grid);
+    terrain.store_batch(points, values);
+    std::vector<cell_value_t> from_terrain( 16 * 16 );
+    wrapped_grid.rasterize_into(from_terrain.data(), 16);
+    EXPECT_EQ( from_terrain, from_grid);
+}
+
+TEST( QuadTreeTest, StoreBatchRejectsMismatchedSizes ){
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    grid::Grid grid(layout);
+    grid.fill(0);
+
+    const std::vector<Vector2d> points = {{1.5, 1.5}, {2.5, 2.5}, {3.5, 3.5}};
+    const std::vector<cell_value_t> short_values = {1, 2};
+    EXPECT_THROW( tree.store_batch(points, short_values), std::invalid_argument);
+    EXPECT_THROW( grid.store_batch(points, short_values), std::invalid_argument);
+    EXPECT_THROW( grid.store_batch({{1.5, 1.5}}, {1, 2}), std::invalid_argument);
+
+    Terrain terrain(grid);
+    EXPECT_THROW( terrain.store_batch(points, short_values), std::invalid_argument);
+
+    // nothing was written
+    EXPECT_EQ( tree.size(), 1);
+    EXPECT_EQ( grid.count_blocked({0,0}, {16,16}), 0);
+}
+
+TEST( QuadTreeTest, IntegrateScan ){
+    const Layout layout(1., 16, 16, 32);
+    quadtree::Tree tree;
+    tree.reset(layout, log_odds_unknown);
+    grid::Grid grid(layout);
+    grid.fill(log_odds_unknown);
+
+    std::mt19937 generator(36);
+    std::uniform_real_distribution<double> coordinate(-4., 36.);
+
+    const Vector2d origin(12.3, 17.6);
+    for( int scan = 0; scan < 20; ++scan ){
+        std::vector<Vector2d> endpoints;
+        for( int ray = 0; ray < 30; ++ray ){
+            endpoints.emplace_back(coordinate(generator), coordinate(generator));
+        }
+        tree.integrate_scan(origin, endpoints);
+        grid.integrate_scan(origin, endpoints);
+    }
+
+    std::vector<cell_value_t> from_tree( 32 * 32 );
+    std::vector<cell_value_t> from_grid( 32 * 32 );
+    tree.rasterize_into(from_tree.data(), 32);
+    grid.rasterize_into(from_grid.data(), 32);
+    ASSERT_EQ( from_tree, from_grid);
+
+    // once free space saturates, re-scanning it changes (and splits) nothing
+    quadtree::Tree empty;
+    empty.reset(layout, 0);
+    empty.integrate_scan({0.5, 0.5}, {{40, 0.5}, {40, 40}, {0.5, -3}});
+    ASSERT_EQ( empty.size(), 1);
+    ASSERT_EQ( empty.classify({3.5, 0.5}), 0);
+}
+
+TEST( QuadTreeTest, QueryThresholdedScan ){
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree tree;
+    tree.reset(layout, log_odds_unknown);
+    grid::Grid grid(layout);
+    grid.fill(log_odds_unknown);
+    grid.build_pyramid();
+
+    // one ray east along the row y=[2,3), ending in the cell x=[5,6)
+    for( int scan = 0; scan < 3; ++scan ){
+        tree.integrate_scan({0.5, 2.5}, {{5.5, 2.5}});
+        grid.integrate_scan({0.5, 2.5}, {{5.5, 2.5}});
+    }
+
+    // raw log-odds do not follow `is_blocked`: even the cells seen free read as blocked
+    EXPECT_EQ( tree.query_box({1, 2}, {5, 3}), Occupancy::Blocked);
+    EXPECT_EQ( grid.query_box({1, 2}, {5, 3}), Occupancy::Blocked);
+
+    const quadtree::Tree before(tree);
+    tree.threshold(log_odds_occupied);
+    grid::threshold(grid, log_odds_occupied);
+
+    EXPECT_EQ( tree.classify({5.5, 2.5}), 0xFF);
+    EXPECT_EQ( tree.classify({2.5, 2.5}), 0);
+    EXPECT_EQ( tree.classify({10.5, 10.5}), 0);
+    EXPECT_EQ( tree.query_box({1, 2}, {5, 3}), Occupancy::Free);
+    EXPECT_EQ( tree.query_box({5, 2}, {6, 3}), Occupancy::Blocked);
+    EXPECT_EQ( tree.query_box({0, 0}, {16, 16}), Occupancy::Mixed);
+    EXPECT_EQ( grid.query_box({1, 2}, {5, 3}), Occupancy::Free);
+    EXPECT_EQ( grid.query_box({5, 2}, {6, 3}), Occupancy::Blocked);
+
+    const auto hit = tree.first_hit({0.5, 2.5}, {15.5, 2.5}, is_blocked);
+    ASSERT_TRUE( hit );
+    EXPECT_DOUBLE_EQ( hit->at.x(), 5.);
+
+    std::vector<cell_value_t> from_tree( 16 * 16 );
+    std::vector<cell_value_t> from_grid( 16 * 16 );
+    tree.rasterize_into(from_tree.data(), 16);
+    grid.rasterize_into(from_grid.data(), 16);
+    EXPECT_EQ( from_tree, from_grid);
+    EXPECT_EQ( std::count(from_tree.begin(), from_tree.end(), 0xFF), 1);
+
+    // only the path down to the single blocked cell is split out; and the earlier version is untouched
+    EXPECT_EQ( tree.size(), 17);
+    EXPECT_EQ( before.classify({5.5, 2.5}), log_odds_unknown + 3*log_odds_hit);
+    EXPECT_EQ( before.classify({10.5, 10.5}), log_odds_unknown);
+}
+
+// every distinct leaf of the tree, found by locating each cell's center
+static std::vector<quadtree::Leaf> all_leaves( const quadtree::Tree& tree ){
+    const Layout& layout = tree.get_layout();
+    std::vector<quadtree::Leaf> leaves;
+    for( size_t j = 0; j < layout.get_dimension(); ++j ){
+        for( size_t i = 0; i < layout.get_dimension(); ++i ){
+            const Vector2d p( layout.get_x_min() + (i + 0.5) * layout.get_precision(),
+                              layout.get_y_min() + (j + 0.5) * layout.get_precision());
+            const quadtree::Leaf leaf = tree.locate(p);
+            if( leaves.end() == std::find(leaves.begin(), leaves.end(), leaf) ){
+                leaves.push_back(leaf);
+            }
+        }
+    }
+    return leaves;
+}
+
+TEST( QuadTreeTest, Neighbors ){
+    const Layout layout(1., 8, 8, 16);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+
+    // one blocked cell, and one 2x2 block: leaves at every depth from 1 to 4
+    const std::vector<cell_value_t> blocked(4, 0x99);
+    tree.store_block( 5, 6, 1, 1, blocked.data(), 1);
+    tree.store_block(12, 0, 2, 2, blocked.data(), 2);
+
+    const auto leaves = all_leaves(tree);
+    ASSERT_EQ( leaves.size(), tree.size() - (tree.size() - 1) / 4);
+
+    const quadtree::Leaf corner = tree.locate({5.5, 6.5});
+    EXPECT_EQ( corner.depth, 4);
+    EXPECT_EQ( tree.sample_leaf(corner).is, 0x99);
+    EXPECT_DOUBLE_EQ( tree.sample_leaf(corner).width, 1.);
+    EXPECT_DOUBLE_EQ( tree.sample_leaf(corner).at.x(), 5.5);
+    EXPECT_DOUBLE_EQ( tree.sample_leaf(corner).at.y(), 6.5);
+
+    // compare each side of every leaf against a walk along the cells just across it
+    std::vector<quadtree::Leaf> found;
+    for( const quadtree::Leaf& leaf : leaves ){
+        const Sample s = tree.sample_leaf(leaf);
+        const double half = s.width / 2;
+        for( const quadtree::Direction direction : {quadtree::Direction::North, quadtree::Direction::East,
+                                                    quadtree::Direction::South, quadtree::Direction::West} ){
+            std::vector<quadtree::Leaf> expected;
+            for( double along = -half + 0.5; along < half; along += 1.0 ){
+                Vector2d across;
+                switch(direction){
+                    case quadtree::Direction::North: across = {s.at.x() + along, s.at.y() + half + 0.5}; break;
+                    case quadtree::Direction::East:  across = {s.at.x() + half + 0.5, s.at.y() + along}; break;
+                    case quadtree::Direction::South: across = {s.at.x() + along, s.at.y() - half - 0.5}; break;
+                    case quadtree::Direction::West:  across = {s.at.x() - half - 0.5, s.at.y() + along}; break;
+                }
+                if( tree.contains(across) ){
+                    const quadtree::Leaf next = tree.locate(across);
+                    if( expected.empty() || ! (expected.back() == next) ){
+                        expected.push_back(next);
+                    }
+                }
+            }
+
+            tree.neighbors(leaf, direction, found);
+            ASSERT_EQ( found.size(), expected.size()) << "    around leaf at: " << s.at.x() << ", " << s.at.y();
+            for( size_t index = 0; index < found.size(); ++index ){
+                EXPECT_TRUE( found[index] == expected[index] );
+            }
+        }
+    }
+}
+
+TEST( QuadTreeTest, CopyTree ){
+    Tree original;
+    original.reset({1., 8, 8, 16}, 0);
+    const std::vector<cell_value_t> blocked = { 0x99 };
+    original.store_block(5, 6, 1, 1, blocked.data(), 1);
+
+    const Tree copy(original);
+    EXPECT_EQ( copy.size(), original.size());
+    EXPECT_EQ( copy.get_layout(), original.get_layout());
+    EXPECT_EQ( copy.classify({5.5, 6.5}), 0x99);
+    EXPECT_EQ( copy.query_box({0, 0}, {16, 16}), Occupancy::Mixed);
+
+    // the copy is independent
+    original.fill(0x99);
+    original.store_block(1, 1, 1, 1, std::vector<cell_value_t>{0}.data(), 1);
+    EXPECT_EQ( copy.classify({1.5, 1.5}), 0);
+    EXPECT_EQ( copy.classify({5.5, 6.5}), 0x99);
+    EXPECT_EQ( copy.classify({9.5, 9.5}), 0);
+    EXPECT_EQ( original.classify({9.5, 9.5}), 0x99);
+}
+
+TEST( QuadTreeTest, VersionHistory ){
+    Tree current;
+    current.reset({1., 16, 16, 32});
+    const size_t full_size = current.size();
+
+    // each version adds one blocked cell to the previous one
+    std::vector<Tree> history;
+    for( int step = 0; step < 8; ++step ){
+        history.emplace_back(current);
+        current.store({ 3.5 * step + 0.5, 2.5 * step + 0.5}, 0x99);
+    }
+
+    for( int version = 0; version < 8; ++version ){
+        EXPECT_EQ( history[version].size(), full_size);
+        for( int step = 0; step < 8; ++step ){
+            const cell_value_t expected = (step < version) ? 0x99 : 0;
+            EXPECT_EQ( history[version].classify({ 3.5 * step + 0.5, 2.5 * step + 0.5}), expected);
+        }
+    }
+    EXPECT_EQ( current.query_box({ 0, 0}, { 32, 32}), Occupancy::Mixed);
+    EXPECT_EQ( history[0].query_box({ 0, 0}, { 32, 32}), Occupancy::Free);
+
+    // dropping old versions leaves the newer ones intact
+    history.erase(history.begin(), history.begin() + 4);
+    current.fill(0);
+    EXPECT_EQ( history.back().classify({ 21.5, 15.5}), 0x99);
+    EXPECT_EQ( history.back().classify({ 24.5, 17.5}), 0);
+}
+
+TEST( QuadTreeTest, PruneAndFillKeepVersionsShared ){
+    Tree current;
+    current.reset({1., 16, 16, 32}, 0);
+    // split the north-east quadrant, but leave it uniform; and block one cell in the south-west
+    current.store({ 24.5, 24.5}, 0x99);
+    current.store({ 24.5, 24.5}, 0);
+    current.store({ 4.5, 4.5}, 0x99);
+    ASSERT_FALSE( current.get_root().get_northeast()->is_leaf());
+
+    const Tree snapshot(current);
+    current.prune();
+
+    // only the blocks above the merged quadrant are copied; the south-west subtree is still shared
+    EXPECT_TRUE( current.get_root().get_northeast()->is_leaf());
+    EXPECT_FALSE( snapshot.get_root().get_northeast()->is_leaf());
+    EXPECT_EQ( current.get_root().get_southwest()->get_southwest(), snapshot.get_root().get_southwest()->get_southwest());
+    EXPECT_EQ( current.classify({ 4.5, 4.5}), 0x99);
+
+    // pruning again finds nothing to merge, and copies nothing
+    const Tree pruned(current);
+    current.prune();
+    EXPECT_EQ( current.get_root().get_northeast(), pruned.get_root().get_northeast());
+
+    current.fill(0x99);
+    EXPECT_TRUE( current.get_root().is_leaf());
+    EXPECT_EQ( current.classify({ 24.5, 24.5}), 0x99);
+    EXPECT_EQ( snapshot.classify({ 4.5, 4.5}), 0x99);
+    EXPECT_EQ( snapshot.classify({ 24.5, 24.5}), 0);
+    EXPECT_EQ( pruned.get_root().get_minimum(), 0);
+}
+
+TEST( QuadTreeTest, CompactRepeatedTiles ){
+    // a 64x64 map tiled with one 8x8 pattern
+    const size_t dimension = 64;
+    std::vector<cell_value_t> cells( dimension * dimension );
+    for( size_t j = 0; j < dimension; ++j ){
+        for( size_t i = 0; i < dimension; ++i ){
+            const size_t u = i % 8;
+            const size_t v = j % 8;
+            cells[j * dimension + i] = ((1 <= u) && (u <= 3) && (2 <= v) && (v <= 6)) ? 0x99 : 0;
+        }
+    }
+
+    Tree tree;
+    tree.reset({1., 32, 32, 64}, 0);
+    tree.store_block(0, 0, dimension, dimension, cells.data(), dimension);
+    const size_t memory_before = tree.get_memory_usage();
+    const double load_before = tree.get_load_factor();
+    std::vector<cell_value_t> before( dimension * dimension );
+    tree.rasterize_into(before.data(), dimension);
+
+    tree.compact();
+    EXPECT_LT( tree.get_memory_usage() * 10, memory_before);
+    EXPECT_LT( tree.get_load_factor(), load_before);
+
+    std::vector<cell_value_t> after( dimension * dimension );
+    tree.rasterize_into(after.data(), dimension);
+    EXPECT_EQ( before, after);
+    EXPECT_EQ( tree.query_box({ 0, 0}, { 64, 64}), Occupancy::Mixed);
+
+    // compacting again finds nothing more to share
+    const size_t compacted = tree.get_memory_usage();
+    tree.compact();
+    EXPECT_EQ( tree.get_memory_usage(), compacted);
+
+    // pruning (as the loaders do) leaves the shared tiles shared, instead of expanding them back into a tree
+    tree.prune();
+    EXPECT_LE( tree.get_memory_usage(), compacted);
+    EXPECT_LT( tree.get_memory_usage() * 10, memory_before);
+    tree.rasterize_into(after.data(), dimension);
+    EXPECT_EQ( before, after);
+
+    // a write into one tile leaves all of its (formerly shared) copies alone
+    tree.store({ 1.5, 2.5}, 0);
+    EXPECT_EQ( tree.classify({ 1.5, 2.5}), 0);
+    EXPECT_EQ( tree.classify({ 9.5, 2.5}), 0x99);
+    EXPECT_EQ( tree.classify({ 1.5, 10.5}), 0x99);
+    EXPECT_EQ( tree.classify({ 57.5, 58.5}), 0x99);
+    EXPECT_GT( tree.get_memory_usage(), compacted);
+}
+
+TEST( QuadTreeTest, OverlayTrees ){
+    const Layout layout(1., 32, 32, 64);
+    const size_t dimension = 64;
+    std::mt19937 generator(49);
+    std::uniform_int_distribution<size_t> corner(0, dimension - 1);
+    std::uniform_int_distribution<size_t> extent(1, 16);
+    const cell_value_t values[] = { 0, 0x40, 0x99, 0xFF };
+    std::uniform_int_distribution<size_t> pick(0, 3);
+
+    // a static map of blocky obstacles, and a sparser dynamic layer
+    auto draw = [&](Tree& tree, const int count){
+        tree.reset(layout, 0);
+        for( int block = 0; block < count; ++block ){
+            const size_t i = corner(generator);
+            const size_t j = corner(generator);
+            const size_t width = std::min(extent(generator), dimension - i);
+            const size_t height = std::min(extent(generator), dimension - j);
+            tree.fill_block(i, j, width, height, values[pick(generator)]);
+        }
+    };
+    Tree a;
+    Tree b;
+    draw(a, 40);
+    draw(b, 12);
+
+    std::vector<cell_value_t> a_cells( dimension * dimension );
+    std::vector<cell_value_t> b_cells( dimension * dimension );
+    a.rasterize_into(a_cells.data(), dimension);
+    b.rasterize_into(b_cells.data(), dimension);
+
+    for( const Combine op : {Combine::Union, Combine::Intersection, Combine::Overlay} ){
+        const Tree result = Tree::overlay(a, b, op);
+
+        std::vector<cell_value_t> expected( dimension * dimension );
+        for( size_t index = 0; index < expected.size(); ++index ){
+            switch(op){
+                case Combine::Union:        expected[index] = std::max(a_cells[index], b_cells[index]); break;
+                case Combine::Intersection: expected[index] = std::min(a_cells[index], b_cells[index]); break;
+                case Combine::Overlay:      expected[index] = (0 < b_cells[index]) ? b_cells[index] : a_cells[index]; break;
+            }
+        }
+        std::vector<cell_value_t> cells( dimension * dimension );
+        result.rasterize_into(cells.data(), dimension);
+        EXPECT_EQ( cells, expected) << "    for op: " << static_cast<int>(op);
+
+        // built pruned
+        Tree pruned(result);
+        pruned.prune();
+        EXPECT_EQ( pruned.size(), result.size());
+    }
+
+    // one side alone decides: nothing beneath it is visited
+    Tree blocked;
+    blocked.reset(layout, 0xFF);
+    Tree empty;
+    empty.reset(layout, 0);
+    EXPECT_EQ( Tree::overlay(a, blocked, Combine::Union).size(), 1);
+    EXPECT_EQ( Tree::overlay(a, empty, Combine::Intersection).size(), 1);
+    EXPECT_EQ( Tree::overlay(a, empty, Combine::Overlay).size(), a.size());
+    EXPECT_EQ( Tree::overlay(empty, b, Combine::Union).size(), b.size());
+}
+
+TEST( QuadTreeTest, OverlayRejectsMismatchedLayouts ){
+    Tree small;
+    small.reset({1., 8, 8, 16}, 0);
+    Tree large;
+    large.reset({1., 16, 16, 32}, 0xFF);
+    EXPECT_THROW( Tree::overlay(small, large, Combine::Union), std::invalid_argument);
+    EXPECT_THROW( Tree::overlay(large, small, Combine::Intersection), std::invalid_argument);
+
+    // same size, shifted
+    Tree shifted;
+    shifted.reset({1., 9, 8, 16}, 0);
+    EXPECT_THROW( Tree::overlay(small, shifted, Combine::Overlay), std::invalid_argument);
+}
+
+TEST( QuadTreeTest, ConcurrentStore ){
+    // the writers interleave by column, so they all race to split the same (initially single) leaf
+    const size_t dimension = 64;
+    const size_t thread_count = 4;
+    Tree tree;
+    tree.reset({1., 32, 32, 64}, 0);
+
+    std::vector<cell_value_t> expected( dimension * dimension, 0);
+    for( size_t j = 0; j < dimension; ++j ){
+        for( size_t i = 0; i < dimension; ++i ){
+            if( 0 == ((i*7 + j*13) % 5) ){
+                // rows of `rasterize_into` run north-to-south
+                expected[(dimension - 1 - j) * dimension + i] = static_cast<cell_value_t>(1 + (i + j) % 200);
+            }
+        }
+    }
+
+    std::vector<std::thread> writers;
+    for( size_t thread_index = 0; thread_index < thread_count; ++thread_index ){
+        writers.emplace_back( [&, thread_index](){
+            for( size_t j = 0; j < dimension; ++j ){
+                for( size_t i = thread_index; i < dimension; i += thread_count ){
+                    const cell_value_t value = expected[(dimension - 1 - j) * dimension + i];
+                    tree.store({ i + 0.5, j + 0.5}, value);
+                }
+            }
+        });
+    }
+    for( auto& writer : writers ){
+        writer.join();
+    }
+
+    std::vector<cell_value_t> written( dimension * dimension );
+    tree.rasterize_into(written.data(), dimension);
+    EXPECT_EQ( written, expected);
+
+    // the summaries settle once the writers finish
+    EXPECT_EQ( tree.query_box({ 0, 0}, { 64, 64}), Occupancy::Mixed);
+    EXPECT_EQ( tree.query_box({ 1.5, 0.5}, { 1.5, 0.5}), Occupancy::Free);
+    EXPECT_EQ( tree.query_box({ 0.5, 0.5}, { 0.5, 0.5}), Occupancy::Blocked);
+}
+
+TEST( QuadTreeTest, ConcurrentStoreWhileDroppingSnapshots ){
+    // writers copy shared blocks on their way down, while another thread drops the versions sharing them
+    const size_t dimension = 64;
+    const size_t thread_count = 4;
+    Tree tree;
+    tree.reset({1., 32, 32, 64});
+    const Tree original(tree);
+
+    for( int round = 0; round < 20; ++round ){
+        std::vector<std::unique_ptr<Tree>> snapshots;
+        for( int copy = 0; copy < 4; ++copy ){
+            snapshots.push_back(std::make_unique<Tree>(tree));
+        }
+
+        const cell_value_t value = static_cast<cell_value_t>(1 + round);
+        std::vector<std::thread> threads;
+        threads.emplace_back( [&](){
+            for( auto& snapshot : snapshots ){
+                std::this_thread::yield();
+                snapshot.reset();
+            }
+        });
+        for( size_t thread_index = 0; thread_index < thread_count; ++thread_index ){
+            threads.emplace_back( [&, thread_index](){
+                for( size_t j = 0; j < dimension; ++j ){
+                    for( size_t i = thread_index; i < dimension; i += thread_count ){
+                        tree.store({ i + 0.5, j + 0.5}, value);
+                    }
+                }
+            });
+        }
+        for( auto& thread : threads ){
+            thread.join();
+        }
+
+        std::vector<cell_value_t> cells( dimension * dimension );
+        tree.rasterize_into(cells.data(), dimension);
+        ASSERT_EQ( cells, std::vector<cell_value_t>(dimension * dimension, value)) << "    in round: " << round;
+    }
+
+    // the first version never saw any of it
+    std::vector<cell_value_t> cells( dimension * dimension );
+    original.rasterize_into(cells.data(), dimension);
+    EXPECT_EQ( cells, std::vector<cell_value_t>(dimension * dimension, 0));
+}
+
+TEST( QuadTreeTest, Balance ){
+    const Layout layout(1., 16, 16, 32);
+    quadtree::Tree tree;
+    tree.reset(layout, 0);
+    const std::vector<cell_value_t> blocked = { 0x99 };
+    tree.store_block( 9, 22, 1, 1, blocked.data(), 1);
+    tree.store_block(30,  1, 1, 1, blocked.data(), 1);
+
+    std::vector<cell_value_t> before( 32 * 32 );
+    tree.rasterize_into(before.data(), 32);
+    const size_t size_before = tree.size();
+
+    tree.balance();
+    EXPECT_LT( size_before, tree.size());
+
+    std::vector<cell_value_t> after( 32 * 32 );
+    tree.rasterize_into(after.data(), 32);
+    EXPECT_EQ( before, after);
+
+    std::vector<quadtree::Leaf> found;
+    for( const quadtree::Leaf& leaf : all_leaves(tree) ){
+        for( const quadtree::Direction direction : {quadtree::Direction::North, quadtree::Direction::East,
+                                                    quadtree::Direction::South, quadtree::Direction::West} ){
+            tree.neighbors(leaf, direction, found);
+            ASSERT_LE( found.size(), 2);
+            for( const quadtree::Leaf& neighbor : found ){
+                ASSERT_LE( neighbor.depth, leaf.depth + 1);
+            }
+        }
+    }
+}
 
 TEST( QuadTreeTest, SavePNG) {
     Terrain<Tree> terrain;